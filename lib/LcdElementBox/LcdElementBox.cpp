@@ -424,7 +424,7 @@ void IconScrollTextBox::setIcon(uint8_t* icon)
 // Implementation of HorizontalBarBox class
 //=================================
 HorizontalBarBox::HorizontalBarBox(int16_t pos_x, int16_t pos_y, uint16_t width, uint16_t height, uint16_t fgColor, uint16_t bgColor, bool bgOpaque)
-    : isUpdated(true), pos_x(pos_x), pos_y(pos_y), width(width), height(height), fgColor(fgColor), bgColor(bgColor), bgOpaque(bgOpaque), level(0)
+    : isUpdated(true), pos_x(pos_x), pos_y(pos_y), width(width), height(height), fgColor(fgColor), bgColor(bgColor), bgOpaque(bgOpaque), level(0), marker(0), markerColor(LCD_GRAY)
 {
 }
 
@@ -459,6 +459,12 @@ void HorizontalBarBox::draw()
     if (w0 < width) {
         LCD_FillBackground(pos_x+w0, pos_y, pos_x+width-1, pos_y+h0-1, !bgOpaque, bgColor);
     }
+    if (marker > 0.0) {
+        uint16_t m0 = (uint16_t) ((float) (width-1) * marker);
+        if (m0 >= w0) {
+            LCD_Fill(pos_x+m0, pos_y, pos_x+m0, pos_y+h0-1, markerColor);
+        }
+    }
 }
 
 void HorizontalBarBox::clear()
@@ -479,3 +485,84 @@ float HorizontalBarBox::getLevel()
 {
     return level;
 }
+
+void HorizontalBarBox::setMarker(float value, uint16_t markerColor) // 0.0 ~ 1.0
+{
+    if (value > 1.0) { value = 1.0; }
+    if (this->marker == value && this->markerColor == markerColor) { return; }
+    this->marker = value;
+    this->markerColor = markerColor;
+    update();
+}
+
+//=================================
+// Implementation of SpectrumBox class
+//=================================
+SpectrumBox::SpectrumBox(int16_t pos_x, int16_t pos_y, uint16_t width, uint16_t height, int numBands, uint16_t fgColor, uint16_t bgColor, bool bgOpaque)
+    : isUpdated(true), pos_x(pos_x), pos_y(pos_y), width(width), height(height),
+      numBands((numBands < MaxBands) ? numBands : MaxBands), fgColor(fgColor), bgColor(bgColor), bgOpaque(bgOpaque),
+      barHeight(), drawnHeight()
+{
+}
+
+void SpectrumBox::setfgColor(uint16_t fgColor)
+{
+    if (this->fgColor == fgColor) { return; }
+    this->fgColor = fgColor;
+    update();
+}
+
+void SpectrumBox::setBgColor(uint16_t bgColor)
+{
+    if (this->bgColor == bgColor) { return; }
+    this->bgColor = bgColor;
+    update();
+}
+
+void SpectrumBox::update()
+{
+    // force full redraw because the area is assumed to be cleared by caller
+    for (int i = 0; i < numBands; i++) { drawnHeight[i] = 0; }
+    isUpdated = true;
+}
+
+void SpectrumBox::draw()
+{
+    if (!isUpdated) { return; }
+    isUpdated = false;
+    // draw only the difference from previous bar height to save SPI bandwidth
+    const uint16_t pitch = width / numBands;
+    const uint16_t barWidth = (pitch > 1) ? pitch - 1 : 1;  // 1px gap between bars
+    const int16_t bottom = pos_y + height - 1;
+    for (int i = 0; i < numBands; i++) {
+        int16_t x0 = pos_x + i * pitch;
+        int16_t x1 = x0 + barWidth - 1;
+        uint16_t h = barHeight[i];
+        if (h > drawnHeight[i]) {
+            LCD_Fill(x0, bottom - h + 1, x1, bottom - drawnHeight[i], fgColor);
+        } else if (h < drawnHeight[i]) {
+            LCD_FillBackground(x0, bottom - drawnHeight[i] + 1, x1, bottom - h, !bgOpaque, bgColor);
+        }
+        drawnHeight[i] = h;
+    }
+}
+
+void SpectrumBox::clear()
+{
+    LCD_FillBackground(pos_x, pos_y, pos_x+width-1, pos_y+height-1, !bgOpaque, bgColor);
+    update();
+}
+
+void SpectrumBox::setLevels(const float* values, int numValues) // 0.0 ~ 1.0
+{
+    if (numValues > numBands) { numValues = numBands; }
+    for (int i = 0; i < numValues; i++) {
+        float value = values[i];
+        if (value < 0.0) { value = 0.0; }
+        if (value > 1.0) { value = 1.0; }
+        uint16_t h = static_cast<uint16_t>(static_cast<float>(height) * value);
+        if (barHeight[i] == h) { continue; }
+        barHeight[i] = h;
+        isUpdated = true;
+    }
+}
@@ -215,6 +215,7 @@ public:
     void clear();
     void setLevel(float value);
     float getLevel();
+    void setMarker(float value, uint16_t markerColor = LCD_GRAY);  // 0.0 to hide
 protected:
     bool isUpdated;
     int16_t pos_x, pos_y;
@@ -223,4 +224,32 @@ protected:
     uint16_t bgColor;
     bool bgOpaque;
     float level;
+    float marker;
+    uint16_t markerColor;
+};
+
+//=================================
+// Definition of SpectrumBox class < LcdElementBox
+//=================================
+class SpectrumBox : public LcdElementBox
+{
+public:
+    static constexpr int MaxBands = 32;
+    SpectrumBox(int16_t pos_x, int16_t pos_y, uint16_t width, uint16_t height, int numBands, uint16_t fgColor = LCD_WHITE, uint16_t bgColor = LCD_BLACK, bool bgOpaque = false);
+    void setfgColor(uint16_t fgColor);
+    void setBgColor(uint16_t bgColor);
+    void update();
+    void draw();
+    void clear();
+    void setLevels(const float* values, int numValues);
+protected:
+    bool isUpdated;
+    int16_t pos_x, pos_y;
+    uint16_t width, height;
+    int numBands;
+    uint16_t fgColor;
+    uint16_t bgColor;
+    bool bgOpaque;
+    uint16_t barHeight[MaxBands];
+    uint16_t drawnHeight[MaxBands];
 };
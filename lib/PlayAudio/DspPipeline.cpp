@@ -0,0 +1,142 @@
+/*------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/------------------------------------------------------*/
+
+#include "DspPipeline.h"
+
+#include <cstdio>
+
+#include "pico/stdlib.h"
+
+DspPipeline::DspPipeline() : stages(), costUs(), bypassed(), numStages(0),
+    budgetUs(0), baseCostUs(0), bypassCount(0)
+{
+}
+
+bool DspPipeline::addStage(DspStage* stage)
+{
+    if (numStages >= MaxStages) { return false; }
+    stages[numStages] = stage;
+    costUs[numStages] = 0;
+    bypassed[numStages] = false;
+    numStages++;
+    return true;
+}
+
+void DspPipeline::setSampFreq(uint32_t sampFreq, uint32_t framesPerBuffer)
+{
+    if (sampFreq == 0) { return; }
+    uint32_t periodUs = static_cast<uint32_t>(static_cast<uint64_t>(framesPerBuffer) * 1000000 / sampFreq);
+    budgetUs = periodUs * BudgetPercent / 100;
+    // start over with all stages since costs scale with sampFreq
+    for (int i = 0; i < numStages; i++) {
+        costUs[i] = 0;
+        bypassed[i] = false;
+    }
+    baseCostUs = 0;
+    bypassCount = 0;
+}
+
+void DspPipeline::setBaseCostUs(uint32_t us)
+{
+    baseCostUs = (baseCostUs * 7 + us + 7) / 8;  // smoothing
+}
+
+bool DspPipeline::hasActiveStage() const
+{
+    for (int i = 0; i < numStages; i++) {
+        if (!bypassed[i] && stages[i]->isActive()) { return true; }
+    }
+    return false;
+}
+
+void DspPipeline::process(int32_t* frames, uint32_t numFrames)
+{
+    for (int i = 0; i < numStages; i++) {
+        if (bypassed[i] || !stages[i]->isActive()) { continue; }
+        uint32_t start = time_us_32();
+        stages[i]->process(frames, numFrames);
+        uint32_t cost = time_us_32() - start;
+        costUs[i] = (costUs[i] * 7 + cost + 7) / 8;  // smoothing
+    }
+    adjustBypass();
+}
+
+void DspPipeline::adjustBypass()
+{
+    uint32_t total = baseCostUs;
+    for (int i = 0; i < numStages; i++) {
+        if (!bypassed[i] && stages[i]->isActive()) { total += costUs[i]; }
+    }
+    if (total > budgetUs) {
+        // bypass the lowest priority (later registered on tie) active stage
+        int victim = -1;
+        for (int i = 0; i < numStages; i++) {
+            if (bypassed[i] || !stages[i]->isActive() || stages[i]->getPriority() == DspStage::PriorityEssential) { continue; }
+            if (victim < 0 || stages[i]->getPriority() >= stages[victim]->getPriority()) { victim = i; }
+        }
+        if (victim >= 0) {
+            bypassed[victim] = true;
+            bypassCount++;
+        }
+    } else {
+        // restore the highest priority bypassed stage if its last known cost fits with margin
+        int cand = -1;
+        for (int i = 0; i < numStages; i++) {
+            if (!bypassed[i]) { continue; }
+            if (cand < 0 || stages[i]->getPriority() < stages[cand]->getPriority()) { cand = i; }
+        }
+        if (cand >= 0 && total + costUs[cand] <= budgetUs * RestorePercent / 100) {
+            bypassed[cand] = false;
+        }
+    }
+}
+
+int DspPipeline::getNumStages() const
+{
+    return numStages;
+}
+
+const char* DspPipeline::getStageName(int idx) const
+{
+    return (idx >= 0 && idx < numStages) ? stages[idx]->getName() : "";
+}
+
+uint32_t DspPipeline::getStageCostUs(int idx) const
+{
+    return (idx >= 0 && idx < numStages) ? costUs[idx] : 0;
+}
+
+bool DspPipeline::isStageBypassed(int idx) const
+{
+    return (idx >= 0 && idx < numStages) ? bypassed[idx] : false;
+}
+
+uint32_t DspPipeline::getTotalCostUs() const
+{
+    uint32_t total = baseCostUs;
+    for (int i = 0; i < numStages; i++) {
+        if (!bypassed[i] && stages[i]->isActive()) { total += costUs[i]; }
+    }
+    return total;
+}
+
+uint32_t DspPipeline::getBudgetUs() const
+{
+    return budgetUs;
+}
+
+uint32_t DspPipeline::getBypassCount() const
+{
+    return bypassCount;
+}
+
+void DspPipeline::printInfo() const
+{
+    printf("DSP: budget %d us, base %d us\n", (int) budgetUs, (int) baseCostUs);
+    for (int i = 0; i < numStages; i++) {
+        printf("DSP: %s %d us%s\n", stages[i]->getName(), (int) costUs[i], bypassed[i] ? " (bypassed)" : "");
+    }
+}
@@ -0,0 +1,65 @@
+/*------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/------------------------------------------------------*/
+
+#pragma once
+
+#include <cstdint>
+
+//=================================
+// Interface of DspStage Class
+//=================================
+// A processing stage on a block of interleaved stereo Q31 frames (in place)
+class DspStage
+{
+public:
+    static constexpr uint8_t PriorityEssential = 0;  // never bypassed
+    DspStage(const char* name, uint8_t priority) : name(name), priority(priority) {}
+    virtual ~DspStage() = default;
+    virtual void process(int32_t* frames, uint32_t numFrames) = 0;
+    virtual bool isActive() const { return true; }  // inactive stage costs nothing and is not measured
+    const char* getName() const { return name; }
+    uint8_t getPriority() const { return priority; }
+protected:
+    const char* name;
+    uint8_t priority;  // larger value is bypassed earlier
+};
+
+//=================================
+// Interface of DspPipeline Class
+//=================================
+// Runs stages in registration order from decode IRQ, measuring each stage per buffer
+// When the sum exceeds the budget derived from buffer period at current sampFreq,
+// the active stage with the lowest priority is bypassed, and restored when room comes back
+class DspPipeline
+{
+public:
+    static constexpr int MaxStages = 8;
+    DspPipeline();
+    bool addStage(DspStage* stage);
+    void setSampFreq(uint32_t sampFreq, uint32_t framesPerBuffer);
+    void setBaseCostUs(uint32_t us);  // cost of decode outside the pipeline
+    bool hasActiveStage() const;
+    void process(int32_t* frames, uint32_t numFrames);
+    void adjustBypass();  // per buffer, also when process() is skipped so that bypassed stages come back
+    int getNumStages() const;
+    const char* getStageName(int idx) const;
+    uint32_t getStageCostUs(int idx) const;
+    bool isStageBypassed(int idx) const;
+    uint32_t getTotalCostUs() const;
+    uint32_t getBudgetUs() const;
+    uint32_t getBypassCount() const;
+    void printInfo() const;
+private:
+    static constexpr uint32_t BudgetPercent = 60;  // of buffer period, rest for IRQ latency, SD and UI
+    static constexpr uint32_t RestorePercent = 80;  // hysteresis against bypass flapping
+    DspStage* stages[MaxStages];
+    uint32_t costUs[MaxStages];
+    bool bypassed[MaxStages];
+    int numStages;
+    uint32_t budgetUs;
+    uint32_t baseCostUs;
+    uint32_t bypassCount;
+};
@@ -0,0 +1,116 @@
+/*------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/------------------------------------------------------*/
+
+#include "LevelMeter.h"
+
+namespace {
+// 10*log10(1 + i/64) * 256 generated at compile time
+constexpr int MantBits = 6;
+constexpr double lnSeries(double x)
+{
+    // ln(x) = 2 * atanh((x-1)/(x+1)), converges quickly for 1 <= x < 2
+    double y = (x - 1.0) / (x + 1.0);
+    double y2 = y * y;
+    double term = y;
+    double sum = 0.0;
+    for (int k = 1; k < 40; k += 2) {
+        sum += term / k;
+        term *= y2;
+    }
+    return 2.0 * sum;
+}
+struct DbTable {
+    int16_t v[1 << MantBits];
+    constexpr DbTable() : v()
+    {
+        constexpr double Ln10 = 2.302585092994046;
+        for (int i = 0; i < (1 << MantBits); i++) {
+            double db = 10.0 * lnSeries(1.0 + static_cast<double>(i) / (1 << MantBits)) / Ln10;
+            v[i] = static_cast<int16_t>(db * 256.0 + 0.5);
+        }
+    }
+};
+constexpr DbTable mantDbQ8;
+constexpr int32_t Db2Q8 = 771;  // 10*log10(2) * 256
+constexpr int FullScaleBits = 30;  // (2^15)^2
+}
+
+LevelMeter::LevelMeter() : windowFrames(1), holdFrames(1)
+{
+    setSampFreq(44100);
+    reset();
+}
+
+void LevelMeter::setSampFreq(uint32_t sampFreq)
+{
+    windowFrames = sampFreq * WindowMs / 1000;
+    holdFrames = sampFreq / 1000 * HoldMs;
+    if (windowFrames == 0) { windowFrames = 1; }
+}
+
+void LevelMeter::reset()
+{
+    sumSq = 0;
+    peak = 0;
+    count = 0;
+    holdCount = 0;
+    rms = 0.0;
+    peakLevel = 0.0;
+    peakHold = 0.0;
+}
+
+bool LevelMeter::isReady() const
+{
+    return count >= windowFrames;
+}
+
+void LevelMeter::integrate()
+{
+    if (count == 0) { return; }
+    // normalized by actual number of samples, thus independent of sampling rate and buffer size
+    uint32_t meanSq = static_cast<uint32_t>(sumSq / count);
+    rms = dbQ8ToLevel(powerToDbQ8(meanSq));
+    peakLevel = dbQ8ToLevel(powerToDbQ8(peak * peak));
+    if (peakLevel >= peakHold || holdCount >= holdFrames) {
+        peakHold = peakLevel;
+        holdCount = 0;
+    } else {
+        holdCount += count;
+    }
+    sumSq = 0;
+    peak = 0;
+    count = 0;
+}
+
+float LevelMeter::getRms() const
+{
+    return rms;
+}
+
+float LevelMeter::getPeak() const
+{
+    return peakLevel;
+}
+
+float LevelMeter::getPeakHold() const
+{
+    return peakHold;
+}
+
+int32_t LevelMeter::powerToDbQ8(uint32_t power)
+{
+    if (power == 0) { return -DbRange * 256 * 2; }
+    int msb = 31 - __builtin_clz(power);
+    uint32_t frac = (msb >= MantBits) ? (power >> (msb - MantBits)) : (power << (MantBits - msb));
+    return (msb - FullScaleBits) * Db2Q8 + mantDbQ8.v[frac & ((1 << MantBits) - 1)];
+}
+
+float LevelMeter::dbQ8ToLevel(int32_t dbQ8)
+{
+    if (dbQ8 <= -DbRange * 256) { return 0.0; }
+    if (dbQ8 >= 0) { return 1.0; }
+    return static_cast<float>(dbQ8 + DbRange * 256) / (DbRange * 256);
+}
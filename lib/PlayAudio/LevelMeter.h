@@ -0,0 +1,50 @@
+/*------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/------------------------------------------------------*/
+
+#pragma once
+
+#include <cstdint>
+
+//=================================
+// Interface of LevelMeter Class
+//=================================
+// RMS and sample peak of one channel integrated over a fixed time window
+// feed() is called per sample from decode IRQ, thus it only accumulates
+class LevelMeter
+{
+public:
+    static constexpr int DbRange = 60;  // dB range mapped to level 0.0 ~ 1.0
+    LevelMeter();
+    void setSampFreq(uint32_t sampFreq);
+    void reset();
+    inline void feed(int32_t sample)
+    {
+        int32_t s = sample >> 16;
+        sumSq += static_cast<uint32_t>(s * s);
+        uint32_t a = static_cast<uint32_t>((s < 0) ? -s : s);
+        if (a > peak) { peak = a; }
+        count++;
+    }
+    bool isReady() const;
+    void integrate();  // close current window and update levels
+    float getRms() const;
+    float getPeak() const;
+    float getPeakHold() const;
+    static int32_t powerToDbQ8(uint32_t power);  // power: full scale = 2^30, return dBFS in Q8
+    static float dbQ8ToLevel(int32_t dbQ8);
+private:
+    static constexpr uint32_t WindowMs = 13;  // same as former 576 samples at 44.1 KHz
+    static constexpr uint32_t HoldMs = 1000;
+    uint64_t sumSq;
+    uint32_t peak;
+    uint32_t count;
+    uint32_t windowFrames;
+    uint32_t holdFrames;
+    uint32_t holdCount;
+    float rms;
+    float peakLevel;
+    float peakHold;
+};
@@ -6,11 +6,13 @@
 
 #include "PlayAudio.h"
 
+#include <cmath>
 #include <cstdio>
 
 #include "pico/stdlib.h"
 
 #include "audio_codec.h"
+#include "io_service.h"
 #include "ReadBuffer.h"
 
 //#define DEBUG_PLAYAUDIO
@@ -37,6 +39,7 @@ void PlayAudio::initialize()
 {
     spin_lock = spin_lock_init(spin_lock_claim_unused(true));
     i2s_setup(44100, ap);  // default 44.1 KHz
+    SpectrumAnalyzer::initialize();
 }
 
 void PlayAudio::finalize()
@@ -65,11 +68,12 @@ uint8_t PlayAudio::getVolume()
     return volume;
 }
 
-PlayAudio::PlayAudio() : playing(false), paused(false), rdbufWarning(false),
+PlayAudio::PlayAudio() : fil(&filBody[0]), playing(false), paused(false), rdbufWarning(false), xfading(false),
     channels(2), sampFreq(0), bitRateKbps(44100*16*2/1000), bitsPerSample(16),
-    samplesPlayed(0), reinitI2s(false), levelL(0.0), levelR(0.0)
+    samplesPlayed(0), reinitI2s(false), levelL(0.0), levelR(0.0), peakL(0.0), peakR(0.0), replayGain(GAIN_UNITY), replayGainNext(GAIN_UNITY)
 {
     rdbuf = ReadBuffer::getInstance();
+    dsp.addStage(&spectrumTap);
 }
 
 PlayAudio::~PlayAudio()
@@ -84,10 +88,18 @@ bool PlayAudio::parseSetPos(size_t fpos)
 void PlayAudio::play(const char* filename, size_t fpos, uint32_t samplesPlayed)
 {
     FRESULT fr;
-    fr = f_open(&fil, (TCHAR *) filename, FA_READ);
-    rdbuf->reqBind(&fil);
+    fr = io_f_open(IO_REQ_AUDIO, fil, (TCHAR *) filename, FA_READ);
+    setupFastSeek(fil);
+    rdbuf->reqBind(fil);
     parseSetPos(fpos);
+    rdbuf->setBitRate(bitRateKbps);
     setSamplesPlayed(samplesPlayed);
+    SpectrumAnalyzer::setSampFreq(sampFreq);
+    for (auto& m : meter) {
+        m.setSampFreq(sampFreq);
+        m.reset();
+    }
+    dsp.setSampFreq(sampFreq, SAMPLES_PER_BUFFER);
 
     if (reinitI2s) {
         audio_codec_dac_enable(false);
@@ -103,6 +115,28 @@ void PlayAudio::play(const char* filename, size_t fpos, uint32_t samplesPlayed)
     rdbufWarning = false;
 }
 
+// build cluster link map table so that f_lseek doesn't follow FAT chain from the head of the file
+void PlayAudio::setupFastSeek(FIL* fp)
+{
+    DWORD* tbl = clmt[fp - filBody];
+    tbl[0] = CLMT_SIZE;
+    fp->cltbl = tbl;
+    FRESULT fr = io_f_lseek(IO_REQ_AUDIO, fp, CREATE_LINKMAP);
+    if (fr == FR_OK) {
+        int fragments = static_cast<int>(tbl[0] - 2) / 2;
+        if (fragments > 1) { printf("AUDIO::file is fragmented into %d\r\n", fragments); }
+    } else {
+        // too many fragments for the table (tbl[0] tells required size): stay with FAT chain
+        if (fr == FR_NOT_ENOUGH_CORE) { printf("AUDIO::file is fragmented into %d (no fast seek)\r\n", static_cast<int>(tbl[0] - 2) / 2); }
+        fp->cltbl = nullptr;
+    }
+}
+
+bool PlayAudio::playNext(const char* filename, uint32_t fadeMs, float gainDb)
+{
+    return false;  // crossfade not supported
+}
+
 void PlayAudio::pause(bool flg)
 {
     paused = flg;
@@ -115,10 +149,18 @@ void PlayAudio::stop()
     playing = false;
     paused = false;
 
-    // it takes some time to stop ReadBuffer due to secondary buffer
+    // it takes some time to stop ReadBuffer until core1 finishes current read
     if (wasPlaying) {
-        rdbuf->reqBind(&fil, false);
-        f_close(&fil);
+        rdbuf->reqBind(fil, false);
+        f_close(fil);  // no disk access for read-only file, then no io_service lock taken (stop() may be called in IRQ)
+        #ifdef DEBUG_PLAYAUDIO
+        printf("AUDIO::read throughput %d KB/s%s\r\n", static_cast<int>(rdbuf->getThroughputKBps()), rdbuf->isContiguous() ? " (raw sector)" : "");
+        printf("AUDIO::card duty %d.%d%%, active %d ms in total\r\n", static_cast<int>(rdbuf->getDutyPermil() / 10), static_cast<int>(rdbuf->getDutyPermil() % 10), static_cast<int>(ReadBuffer::getCardActiveMs()));
+        printf("AUDIO::read latency %d ms (99%%), cushion %d KB\r\n", static_cast<int>(ReadBuffer::getLatencyMs()), static_cast<int>(rdbuf->getCushionBytes() / 1024));
+        io_print_stats();
+        if (ReadBuffer::getErrorCount() > 0) { ReadBuffer::printErrorStats(); }
+        if (dsp.getBypassCount() > 0) { dsp.printInfo(); }
+        #endif // DEBUG_PLAYAUDIO
     }
 }
 
@@ -127,6 +169,11 @@ bool PlayAudio::isPlaying()
     return playing;
 }
 
+bool PlayAudio::isCrossfading()
+{
+    return xfading;
+}
+
 bool PlayAudio::isPaused()
 {
     return paused;
@@ -147,15 +194,6 @@ uint32_t PlayAudio::getU28BE(const char* ptr)
     return (((uint32_t) ptr[0] & 0x7f) << 21) + (((uint32_t) ptr[1] & 0x7f) << 14) + (((uint32_t) ptr[2] & 0x7f) << 7) + (((uint32_t) ptr[3] & 0x7f));
 }
 
-float PlayAudio::convLevelCurve(uint32_t levelInt) // assume 0 <= level <= 32768
-{
-    int i;
-    for (i = 0; i < 101; i++) {
-        if (levelInt*2 < vol_table[i]) { break; }
-    }
-    return (float) i / 100.0;
-}
-
 void PlayAudio::setSamplesPlayed(uint32_t value)
 {
     uint32_t save = spin_lock_blocking(spin_lock);
@@ -178,28 +216,20 @@ uint32_t PlayAudio::getSamplesPlayed()
     return value;
 }
 
-void PlayAudio::setLevelInt(uint32_t levelIntL, uint32_t levelIntR)
+void PlayAudio::updateLevel()
 {
-    uint32_t save;
     // Level conversion with slow level down
     const float MaxLevelDown = 0.02;
 
-    float levelL_nxt = convLevelCurve(levelIntL);
-    save = spin_lock_blocking(spin_lock);
-    if (levelL - MaxLevelDown > levelL_nxt) {
-        levelL -= MaxLevelDown;
-    } else {
-        levelL = levelL_nxt;
-    }
-    spin_unlock(spin_lock, save);
-
-    float levelR_nxt = convLevelCurve(levelIntR);
-    save = spin_lock_blocking(spin_lock);
-    if (levelR - MaxLevelDown > levelR_nxt) {
-        levelR -= MaxLevelDown;
-    } else {
-        levelR = levelR_nxt;
-    }
+    meter[0].integrate();
+    meter[1].integrate();
+    float levelL_nxt = meter[0].getRms();
+    float levelR_nxt = meter[1].getRms();
+    uint32_t save = spin_lock_blocking(spin_lock);
+    levelL = (levelL - MaxLevelDown > levelL_nxt) ? levelL - MaxLevelDown : levelL_nxt;
+    levelR = (levelR - MaxLevelDown > levelR_nxt) ? levelR - MaxLevelDown : levelR_nxt;
+    peakL = meter[0].getPeakHold();
+    peakR = meter[1].getPeakHold();
     spin_unlock(spin_lock, save);
 }
 
@@ -225,6 +255,8 @@ void PlayAudio::decode()
     give_audio_buffer(ap, buffer);
     levelL = 0.0;
     levelR = 0.0;
+    peakL = 0.0;
+    peakR = 0.0;
 
     #ifdef DEBUG_PLAYAUDIO
     uint32_t time = to_ms_since_boot(get_absolute_time()) - start;
@@ -268,6 +300,41 @@ void PlayAudio::getLevel(float* levelL, float* levelR)
     spin_unlock(spin_lock, save);
 }
 
+void PlayAudio::getPeakLevel(float* peakL, float* peakR)
+{
+    uint32_t save = spin_lock_blocking(spin_lock);
+    *peakL = this->peakL;
+    *peakR = this->peakR;
+    spin_unlock(spin_lock, save);
+}
+
+void PlayAudio::setReplayGain(float gainDb)
+{
+    replayGain = dbToGain(gainDb);
+}
+
+const DspPipeline& PlayAudio::getDspPipeline() const
+{
+    return dsp;
+}
+
+int32_t PlayAudio::dbToGain(float gainDb)
+{
+    const float MinGainDb = -24.0;
+    const float MaxGainDb = 12.0;
+    if (gainDb < MinGainDb) { gainDb = MinGainDb; }
+    if (gainDb > MaxGainDb) { gainDb = MaxGainDb; }
+    return static_cast<int32_t>(static_cast<float>(GAIN_UNITY) * powf(10.0f, gainDb / 20.0f));
+}
+
+int32_t PlayAudio::getVolumeMultiplier(const int32_t& gain)
+{
+    // combine volume and replay gain into single multiplier per buffer
+    // saturate at unity so that positive replay gain never clips at full volume
+    int64_t mul = static_cast<int64_t>(vol_table[volume]) * gain / GAIN_UNITY;
+    return (mul < GAIN_UNITY) ? static_cast<int32_t>(mul) : GAIN_UNITY;
+}
+
 uint32_t PlayAudio::getSampFreq()
 {
     return sampFreq;
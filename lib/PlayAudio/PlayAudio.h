@@ -10,6 +10,14 @@
 
 #include "ff.h"
 #include "i2s_audio_init.h"
+#include "DspPipeline.h"
+#include "LevelMeter.h"
+#include "SpectrumAnalyzer.h"
+
+// cluster link map is required for fast seek, resume and raw sector streaming of contiguous files
+#if !FF_USE_FASTSEEK
+#error "FF_USE_FASTSEEK must be enabled in ffconf.h"
+#endif
 
 class ReadBuffer; // to avoid inter-lock
 
@@ -23,25 +31,29 @@ public:
         AUDIO_CODEC_NONE = 0,
         AUDIO_CODEC_WAV
     } audio_codec_t;
-    static constexpr int RDBUF_SIZE = SAMPLES_PER_BUFFER * 8;  // 4 (16bit), 6 (24bit), 8 (32bit)
-    static constexpr int RDBUF_THRESHOLD = RDBUF_SIZE / 4;
     static void initialize();
     static void finalize();
     static void volumeUp();
     static void volumeDown();
     static void setVolume(uint8_t value);
     static uint8_t getVolume();
+    static constexpr int32_t GAIN_UNITY = 65536;  // 0 dB in Q16
     PlayAudio();
     virtual ~PlayAudio();
     virtual void play(const char* filename, size_t fpos = 0, uint32_t samplesPlayed = 0);
+    virtual bool playNext(const char* filename, uint32_t fadeMs, float gainDb = 0.0);  // crossfade into next file (with its ReplayGain) while playing
     void pause(bool flg = true);
-    void stop();
+    virtual void stop();
+    bool isCrossfading();
     bool isPlaying();
     bool isPaused();
     uint32_t elapsedMillis();
     virtual uint32_t totalMillis() = 0;
     virtual void getCurrentPosition(size_t* fpos, uint32_t* samplesPlayed);
     void getLevel(float* levelL, float* levelR);
+    void getPeakLevel(float* peakL, float* peakR);  // with peak-hold
+    void setReplayGain(float gainDb);
+    const DspPipeline& getDspPipeline() const;  // per-stage cost and bypass state for diagnostics
     uint32_t getSampFreq();
     uint16_t getBitsPerSample();
 protected:
@@ -49,10 +61,14 @@ protected:
     static audio_buffer_pool_t* ap;
     static uint8_t volume;
     static const int32_t vol_table[101];
-    FIL fil;
+    static constexpr int CLMT_SIZE = 64;  // cluster link map table for fast seek (up to 31 fragments)
+    FIL filBody[2];  // [1] for crossfade stream
+    FIL* fil;
+    DWORD clmt[2][CLMT_SIZE];  // for filBody[0], [1]
     bool playing;
     bool paused;
     bool rdbufWarning;
+    volatile bool xfading;
     uint16_t channels;
     uint32_t sampFreq;
     uint16_t bitRateKbps;
@@ -61,17 +77,29 @@ protected:
     bool reinitI2s;
     float levelL;
     float levelR;
+    float peakL;
+    float peakR;
+    LevelMeter meter[2];
+    DspPipeline dsp;  // optional processing between decode and volume
+    SpectrumTapStage spectrumTap;
+    int32_t replayGain;  // Q16 linear gain applied together with volume
+    int32_t replayGainNext;  // Q16 linear gain of crossfade stream
     ReadBuffer* rdbuf; // Read buffer for Audio codec stream
     uint16_t getU16LE(const char* ptr);
     uint32_t getU32LE(const char* ptr);
     uint32_t getU28BE(const char* ptr);
+    void setupFastSeek(FIL* fp);
     void setSamplesPlayed(uint32_t value);
     void incSamplesPlayed(uint32_t inc);
     uint32_t getSamplesPlayed();
-    void setLevelInt(uint32_t levelIntL, uint32_t levelIntR);
+    void updateLevel();
+    static int32_t dbToGain(float gainDb);
+    int32_t getVolumeMultiplier(const int32_t& gain);
+    static inline int32_t applyVolume(int32_t sample, int32_t volMul)
+    {
+        return static_cast<int32_t>((static_cast<int64_t>(sample) * volMul / 65536)) + DAC_ZERO;
+    }
     virtual bool parseSetPos(size_t fpos);
     virtual void decode();
     virtual bool isMuteCondition();
-private:
-    float convLevelCurve(uint32_t levelInt);
 };
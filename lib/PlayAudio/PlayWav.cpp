@@ -7,16 +7,51 @@
 #include "PlayWav.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
 
 #include "pico/stdlib.h"
 
+#include "io_service.h"
 #include "ReadBuffer.h"
 
 //#define DEBUG_PLAYWAV
 
 PlayWav* PlayWav::g_inst = nullptr;
+int16_t PlayWav::xfadeTable[XFADE_TABLE_SIZE + 1];
+
+template <int BYTES>
+static inline int32_t loadSample(const uint8_t* ptr)  // little endian PCM to Q31
+{
+    if (BYTES == 2) { return static_cast<int32_t>((ptr[1] << 24) | (ptr[0] << 16)); }
+    if (BYTES == 3) { return static_cast<int32_t>((ptr[2] << 24) | (ptr[1] << 16) | (ptr[0] << 8)); }
+    return static_cast<int32_t>((ptr[3] << 24) | (ptr[2] << 16) | (ptr[1] << 8) | (ptr[0] << 0));
+}
+
+template <int BYTES, bool FUSE_VOLUME>
+void PlayWav::decodeFrames(int32_t* samples, const uint8_t* buf, uint32_t numFrames, int32_t volMul)
+{
+    const int chOfs = (channels == 2) ? BYTES : 0;
+    for (uint32_t i = 0; i < numFrames; i++, buf += blockBytes) {
+        int32_t sampleL = loadSample<BYTES>(buf);
+        int32_t sampleR = loadSample<BYTES>(buf + chOfs);
+        meter[0].feed(sampleL);
+        meter[1].feed(sampleR);
+        samples[i*2+0] = FUSE_VOLUME ? applyVolume(sampleL, volMul) : sampleL;
+        samples[i*2+1] = FUSE_VOLUME ? applyVolume(sampleR, volMul) : sampleR;
+    }
+}
+
+template <int BYTES>
+static void decodeRawFrames(int32_t* samples, const uint8_t* buf, uint32_t numFrames, uint16_t blockBytes, uint16_t channels)
+{
+    const int chOfs = (channels == 2) ? BYTES : 0;
+    for (uint32_t i = 0; i < numFrames; i++, buf += blockBytes) {
+        samples[i*2+0] = loadSample<BYTES>(buf);
+        samples[i*2+1] = loadSample<BYTES>(buf + chOfs);
+    }
+}
 
 void PlayWav::decode_func()
 {
@@ -24,26 +59,24 @@ void PlayWav::decode_func()
     g_inst->decode();
 }
 
-PlayWav::PlayWav() : PlayAudio()
+PlayWav::PlayWav() : PlayAudio(), filNext(&filBody[1]), rdbufNext(ReadBuffer::getInstance(1)), fmtNext(), xfadeFrames(0), xfadeDone(0)
 {
     g_inst = this;
+    // crossfade stream is allocated at boot rather than in the middle of playback, crossfade is disabled if it failed
+    if (rdbufNext == nullptr) { printf("ERROR: no memory for crossfade stream\r\n"); }
+    const float Pi = 3.14159265f;
+    for (int i = 0; i <= XFADE_TABLE_SIZE; i++) {
+        xfadeTable[i] = static_cast<int16_t>(lrintf(32767.0f * sinf(Pi / 2.0f * i / XFADE_TABLE_SIZE)));
+    }
 }
 
 PlayWav::~PlayWav()
 {
 }
 
-void PlayWav::play(const char* filename, size_t fpos, uint32_t samplesPlayed)
+bool PlayWav::parseFormat(ReadBuffer* rb, WavFormat_t& fmt)
 {
-    accum[0] = 0;
-    accum[1] = 0;
-    accumCount = 0;
-    PlayAudio::play(filename, fpos, samplesPlayed);
-}
-
-void PlayWav::skipToDataChunk()
-{
-    const char* buf = reinterpret_cast<const char*>(rdbuf->buf());
+    const char* buf = reinterpret_cast<const char*>(rb->buf());
     if (buf[ 0]=='R' && buf[ 1]=='I' && buf[ 2]=='F' && buf[ 3]=='F' &&
         buf[ 8]=='W' && buf[ 9]=='A' && buf[10]=='V' && buf[11]=='E')
     {
@@ -52,25 +85,84 @@ void PlayWav::skipToDataChunk()
             const char* chunk_id = buf + ofs;
             const uint32_t size = getU32LE(buf + ofs + 4);
             if (memcmp(chunk_id, "fmt ", 4) == 0) {
-                uint32_t sf;
-                format        = static_cast<uint16_t>(getU16LE(buf + ofs + 4 + 4)); // format
-                channels      = static_cast<uint16_t>(getU16LE(buf + ofs + 4 + 4 + 2)); // channels
-                sf            = static_cast<uint32_t>(getU32LE(buf + ofs + 4 + 4 + 2 + 2)); // samplerate
-                bitRateKbps   = static_cast<uint16_t>(getU32LE(buf + ofs + 4 + 4 + 2 + 2 + 4) /* bytepersec */ * 8 / 1000); // Kbps
-                blockBytes    = static_cast<uint16_t>(getU16LE(buf + ofs + 4 + 4 + 2 + 2 + 4 + 4)); // blockBytes
-                bitsPerSample = static_cast<uint16_t>(getU16LE(buf + ofs + 4 + 4 + 2 + 2 + 4 + 4 + 2)); // bitswidth
-                reinitI2s = (sampFreq != sf);
-                sampFreq = sf;
+                fmt.format        = static_cast<uint16_t>(getU16LE(buf + ofs + 4 + 4)); // format
+                fmt.channels      = static_cast<uint16_t>(getU16LE(buf + ofs + 4 + 4 + 2)); // channels
+                fmt.sampFreq      = static_cast<uint32_t>(getU32LE(buf + ofs + 4 + 4 + 2 + 2)); // samplerate
+                fmt.bitRateKbps   = static_cast<uint16_t>(getU32LE(buf + ofs + 4 + 4 + 2 + 2 + 4) /* bytepersec */ * 8 / 1000); // Kbps
+                fmt.blockBytes    = static_cast<uint16_t>(getU16LE(buf + ofs + 4 + 4 + 2 + 2 + 4 + 4)); // blockBytes
+                fmt.bitsPerSample = static_cast<uint16_t>(getU16LE(buf + ofs + 4 + 4 + 2 + 2 + 4 + 4 + 2)); // bitswidth
             } else if (memcmp(chunk_id, "data", 4) == 0) {
-                dataSize = size;
-                rdbuf->setEodPos(ofs + 8 + dataSize);
-                rdbuf->shift(ofs + 8);
-                return;
+                fmt.dataSize = size;
+                rb->setEodPos(ofs + 8 + fmt.dataSize);
+                rb->shift(ofs + 8);
+                return true;
             }
             ofs += 8 + size;
-            if (ofs + 8 > rdbuf->getLeft()) { return; }
+            if (ofs + 8 > rb->getLeft()) { return false; }
         }
     }
+    return false;
+}
+
+void PlayWav::skipToDataChunk()
+{
+    WavFormat_t fmt = {};
+    parseFormat(rdbuf, fmt);
+    if (fmt.blockBytes == 0) { return; }  // no fmt chunk
+    format        = fmt.format;
+    channels      = fmt.channels;
+    bitRateKbps   = fmt.bitRateKbps;
+    blockBytes    = fmt.blockBytes;
+    bitsPerSample = fmt.bitsPerSample;
+    dataSize      = fmt.dataSize;
+    reinitI2s = (sampFreq != fmt.sampFreq);
+    sampFreq = fmt.sampFreq;
+}
+
+bool PlayWav::playNext(const char* filename, uint32_t fadeMs, float gainDb)
+{
+    if (!playing || paused || xfading || rdbufNext == nullptr) { return false; }
+    if (io_f_open(IO_REQ_AUDIO, filNext, (TCHAR *) filename, FA_READ) != FR_OK) { return false; }
+    setupFastSeek(filNext);
+    rdbufNext->reqBind(filNext);
+    WavFormat_t fmt = {};
+    bool supported = parseFormat(rdbufNext, fmt) && fmt.format == FMT_PCM && fmt.sampFreq == sampFreq &&
+        (fmt.channels == 1 || fmt.channels == 2) && (fmt.bitsPerSample == 16 || fmt.bitsPerSample == 24 || fmt.bitsPerSample == 32);
+    if (!supported) {  // requires same sampFreq because I2S keeps running through the transition
+        rdbufNext->reqBind(filNext, false);
+        io_f_close(IO_REQ_AUDIO, filNext);
+        return false;
+    }
+    fmtNext = fmt;
+    rdbufNext->setBitRate(fmt.bitRateKbps);
+    uint32_t leftMillis = totalMillis() - elapsedMillis();
+    xfadeFrames = static_cast<uint32_t>(static_cast<uint64_t>(std::min(fadeMs, leftMillis)) * sampFreq / 1000);
+    if (xfadeFrames == 0) { xfadeFrames = 1; }
+    xfadeDone = 0;
+    replayGainNext = dbToGain(gainDb);
+    uint32_t save = spin_lock_blocking(spin_lock);
+    xfading = true;
+    spin_unlock(spin_lock, save);
+    printf("WAV::crossfade %d ms\n", static_cast<int>(std::min(fadeMs, leftMillis)));
+    return true;
+}
+
+void PlayWav::stop()
+{
+    abortCrossfade();
+    PlayAudio::stop();
+}
+
+void PlayWav::abortCrossfade()
+{
+    uint32_t save = spin_lock_blocking(spin_lock);
+    bool wasXfading = xfading;
+    xfading = false;
+    spin_unlock(spin_lock, save);
+    if (wasXfading) {
+        rdbufNext->reqBind(filNext, false);
+        f_close(filNext);  // may be in IRQ through stop()
+    }
 }
 
 bool PlayWav::parseSetPos(size_t fpos)
@@ -84,7 +176,9 @@ void PlayWav::decode()
 {
     if (ap == nullptr) { return; }
 
-    if (isMuteCondition()) {
+    // core1 has not caught up yet (not the end of data): mute instead of a short buffer
+    bool underrun = !xfading && rdbuf->getLeft() < blockBytes && !rdbuf->reachedEod();
+    if (isMuteCondition() || underrun) {
         PlayAudio::decode();
         return;
     }
@@ -98,34 +192,63 @@ void PlayWav::decode()
     #endif // DEBUG_PLAYWAV
 
     int32_t* samples = reinterpret_cast<int32_t*>(buffer->buffer->bytes);
+    const int32_t volMul = getVolumeMultiplier(replayGain);
     const uint8_t* buf = rdbuf->buf();
-    buffer->sample_count = std::min(static_cast<uint32_t>(rdbuf->getLeft()/blockBytes), buffer->max_sample_count);
-    for (int i = 0; i < buffer->sample_count; i++, buf += blockBytes) {
-        for (int j = 0; j < 2; j++) {
-            int base = (channels == 2) ? j * bitsPerSample / 8 : 0;
-            int32_t buf_s32;
-            switch ((format << 8) | bitsPerSample) {
-                case ((FMT_PCM   << 8) | 16): buf_s32 = static_cast<int32_t>((buf[base+1] << 24) | (buf[base+0] << 16)); break;
-                case ((FMT_PCM   << 8) | 24): buf_s32 = static_cast<int32_t>((buf[base+2] << 24) | (buf[base+1] << 16) | (buf[base+0] << 8)); break;
-                case ((FMT_PCM   << 8) | 32): buf_s32 = static_cast<int32_t>((buf[base+3] << 24) | (buf[base+2] << 16) | (buf[base+1] << 8) | (buf[base+0] << 0)); break;
-                case ((FMT_FLOAT << 8) | 32): buf_s32 = 0; break;
-                default: buf_s32 = 0; break;
-            }
-            samples[i*2+j] = static_cast<int32_t>((static_cast<int64_t>(buf_s32) * vol_table[volume] / 65536)) + DAC_ZERO;
-            accum[j] += (buf_s32/65536) * (buf_s32/65536) / 32768 * 44100 / sampFreq;  // normalized to 44100 Hz's level
+    const bool mixing = xfading;  // one branch per buffer, single stream path stays as is
+    if (mixing) {
+        // up to the end of ring of either stream so that no gap comes at wrap, the rest comes with next buffer
+        // a stream with nothing left doesn't limit it (continue with silence even if either stream runs short)
+        uint32_t curFrames = static_cast<uint32_t>(rdbuf->getContiguous()/blockBytes);
+        uint32_t nextFrames = static_cast<uint32_t>(rdbufNext->getContiguous()/fmtNext.blockBytes);
+        buffer->sample_count = buffer->max_sample_count;
+        if (curFrames > 0) { buffer->sample_count = std::min(curFrames, buffer->sample_count); }
+        if (nextFrames > 0) { buffer->sample_count = std::min(nextFrames, buffer->sample_count); }
+    } else {
+        // frames up to the end of ring (mirror included) at once, the rest comes with next buffer
+        buffer->sample_count = std::min(static_cast<uint32_t>(rdbuf->getContiguous()/blockBytes), buffer->max_sample_count);
+    }
+    const uint32_t numFrames = buffer->sample_count;
+    // volume is fused into decode loop unless any optional stage needs pre-volume frames
+    const bool fused = !dsp.hasActiveStage() && !mixing;
+    uint32_t baseStart = time_us_32();
+    if (mixing) {
+        decodeCrossfade(samples, numFrames);
+    } else {
+        switch ((format << 8) | bitsPerSample) {
+            case ((FMT_PCM << 8) | 16):
+                if (fused) { decodeFrames<2, true>(samples, buf, numFrames, volMul); } else { decodeFrames<2, false>(samples, buf, numFrames, volMul); }
+                break;
+            case ((FMT_PCM << 8) | 24):
+                if (fused) { decodeFrames<3, true>(samples, buf, numFrames, volMul); } else { decodeFrames<3, false>(samples, buf, numFrames, volMul); }
+                break;
+            case ((FMT_PCM << 8) | 32):
+                if (fused) { decodeFrames<4, true>(samples, buf, numFrames, volMul); } else { decodeFrames<4, false>(samples, buf, numFrames, volMul); }
+                break;
+            case ((FMT_FLOAT << 8) | 32): // fallthrough
+            default:
+                for (uint32_t i = 0; i < numFrames * 2; i++) { samples[i] = fused ? DAC_ZERO : 0; }
+                break;
+        }
+    }
+    dsp.setBaseCostUs(time_us_32() - baseStart);
+    if (!fused) {
+        dsp.process(samples, numFrames);
+        const int32_t mul = mixing ? GAIN_UNITY : volMul; // volume of each voice is in the mix
+        for (uint32_t i = 0; i < numFrames * 2; i++) {
+            samples[i] = applyVolume(samples[i], mul);
         }
-        accumCount++;
+    } else {
+        dsp.adjustBypass();
     }
     give_audio_buffer(ap, buffer);
     incSamplesPlayed(buffer->sample_count);
-    if (accumCount >= 576 * sampFreq / 44100) {  // normalized to 44100 Hz's timing
-        setLevelInt(accum[0] / buffer->sample_count, accum[1] / buffer->sample_count);
-        accum[0] = 0;
-        accum[1] = 0;
-        accumCount = 0;
+    if (meter[0].isReady()) { updateLevel(); }
+    if (mixing) {
+        if (xfadeDone >= xfadeFrames) { finishCrossfade(); }
+    } else {
+        rdbuf->shift(buffer->sample_count*blockBytes);
+        if (rdbuf->reachedEod() && rdbuf->getLeft() < blockBytes) { stop(); }
     }
-    rdbuf->shift(buffer->sample_count*blockBytes);
-    if (rdbuf->getLeft()/channels/blockBytes == 0) { stop(); }
 
     #ifdef DEBUG_PLAYWAV
     uint32_t time = static_cast<uint32_t>(to_us_since_boot(get_absolute_time()) - start);
@@ -135,6 +258,79 @@ void PlayWav::decode()
     #endif // DEBUG_PLAYWAV
 }
 
+static uint32_t decodeRaw(uint16_t bitsPerSample, int32_t* samples, const uint8_t* buf, uint32_t numFrames, uint16_t blockBytes, uint16_t channels)
+{
+    switch (bitsPerSample) {
+        case 16: decodeRawFrames<2>(samples, buf, numFrames, blockBytes, channels); break;
+        case 24: decodeRawFrames<3>(samples, buf, numFrames, blockBytes, channels); break;
+        case 32: decodeRawFrames<4>(samples, buf, numFrames, blockBytes, channels); break;
+        default: return 0;
+    }
+    return numFrames;
+}
+
+void PlayWav::decodeCrossfade(int32_t* samples, uint32_t numFrames)
+{
+    // current voice fades out by cos, next voice fades in by sin (equal power)
+    uint32_t curFrames = std::min(static_cast<uint32_t>(rdbuf->getContiguous()/blockBytes), numFrames);
+    uint32_t nextFrames = std::min(static_cast<uint32_t>(rdbufNext->getContiguous()/fmtNext.blockBytes), numFrames);
+    uint32_t curDecoded = (format == FMT_PCM) ? decodeRaw(bitsPerSample, samples, rdbuf->buf(), curFrames, blockBytes, channels) : 0;
+    uint32_t nextDecoded = decodeRaw(fmtNext.bitsPerSample, xfadeBuf, rdbufNext->buf(), nextFrames, fmtNext.blockBytes, fmtNext.channels);
+    for (uint32_t i = curDecoded * 2; i < numFrames * 2; i++) { samples[i] = 0; }
+    for (uint32_t i = nextDecoded * 2; i < numFrames * 2; i++) { xfadeBuf[i] = 0; }
+
+    // gain is interpolated linearly inside the buffer between table points at both ends
+    uint32_t end = std::min(xfadeDone + numFrames, xfadeFrames);
+    int32_t idx0 = static_cast<int32_t>(static_cast<uint64_t>(xfadeDone) * XFADE_TABLE_SIZE / xfadeFrames);
+    int32_t idx1 = static_cast<int32_t>(static_cast<uint64_t>(end) * XFADE_TABLE_SIZE / xfadeFrames);
+    int32_t gIn = static_cast<int32_t>(xfadeTable[idx0]) << 16;
+    int32_t gOut = static_cast<int32_t>(xfadeTable[XFADE_TABLE_SIZE - idx0]) << 16;
+    int32_t stepIn = ((static_cast<int32_t>(xfadeTable[idx1]) << 16) - gIn) / static_cast<int32_t>(numFrames);
+    int32_t stepOut = ((static_cast<int32_t>(xfadeTable[XFADE_TABLE_SIZE - idx1]) << 16) - gOut) / static_cast<int32_t>(numFrames);
+    // each voice has its own multiplier of volume and ReplayGain (saturated at unity each), then no volume after the mix
+    const int64_t mulCur = getVolumeMultiplier(replayGain);
+    const int64_t mulNext = getVolumeMultiplier(replayGainNext);
+    for (uint32_t i = 0; i < numFrames; i++) {
+        for (int j = 0; j < 2; j++) {
+            int64_t cur = static_cast<int64_t>(samples[i*2+j]) * (gOut >> 16);
+            int64_t next = static_cast<int64_t>(xfadeBuf[i*2+j]) * (gIn >> 16);
+            int64_t mix = (cur * mulCur + next * mulNext) / GAIN_UNITY >> 15;
+            int64_t level = (cur + next) >> 15; // before volume as single stream
+            if (mix > INT32_MAX) { mix = INT32_MAX; }
+            if (mix < INT32_MIN) { mix = INT32_MIN; }
+            if (level > INT32_MAX) { level = INT32_MAX; }
+            if (level < INT32_MIN) { level = INT32_MIN; }
+            samples[i*2+j] = static_cast<int32_t>(mix);
+            meter[j].feed(static_cast<int32_t>(level));
+        }
+        gIn += stepIn;
+        gOut += stepOut;
+    }
+    rdbuf->shift(curFrames * blockBytes);
+    rdbufNext->shift(nextFrames * fmtNext.blockBytes);
+    xfadeDone += numFrames;
+}
+
+void PlayWav::finishCrossfade()
+{
+    // called from decode: retire current voice and promote next voice
+    rdbuf->reqBind(fil, false);
+    f_close(fil);  // no disk access for read-only file, then no io_service lock taken in IRQ
+    std::swap(fil, filNext);
+    std::swap(rdbuf, rdbufNext);
+    format        = fmtNext.format;
+    channels      = fmtNext.channels;
+    bitRateKbps   = fmtNext.bitRateKbps;
+    blockBytes    = fmtNext.blockBytes;
+    bitsPerSample = fmtNext.bitsPerSample;
+    dataSize      = fmtNext.dataSize;
+    replayGain    = replayGainNext;
+    setSamplesPlayed(xfadeDone);
+    rdbufWarning = false;
+    xfading = false;
+    if (rdbuf->reachedEod() && rdbuf->getLeft() < blockBytes) { stop(); }
+}
+
 uint32_t PlayWav::totalMillis()
 {
     return  std::max(
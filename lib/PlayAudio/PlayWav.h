@@ -17,18 +17,41 @@ public:
     static void decode_func();
     PlayWav();
     ~PlayWav();
-    void play(const char* filename, size_t fpos = 0, uint32_t samplesPlayed = 0);
+    bool playNext(const char* filename, uint32_t fadeMs, float gainDb = 0.0);
+    void stop();
     uint32_t totalMillis();
 protected:
     static constexpr uint16_t FMT_PCM   = 1;
     static constexpr uint16_t FMT_FLOAT = 3;
+    static constexpr int XFADE_TABLE_SIZE = 256;
+    typedef struct {
+        uint16_t format;
+        uint16_t channels;
+        uint32_t sampFreq;
+        uint16_t bitRateKbps;
+        uint16_t blockBytes;
+        uint16_t bitsPerSample;
+        uint32_t dataSize;
+    } WavFormat_t;
     static PlayWav* g_inst;
+    static int16_t xfadeTable[XFADE_TABLE_SIZE + 1];  // sin(pi/2 * i/SIZE) in Q15
     uint32_t dataSize;
     uint16_t blockBytes;
     uint16_t format;  // 1: PCM, 3: IEEE float
-    uint32_t accum[2] = {};
-    uint32_t accumCount;
+    // crossfade (next voice)
+    FIL* filNext;
+    ReadBuffer* rdbufNext;
+    WavFormat_t fmtNext;
+    uint32_t xfadeFrames;
+    uint32_t xfadeDone;
+    int32_t xfadeBuf[SAMPLES_PER_BUFFER * 2];
+    bool parseFormat(ReadBuffer* rb, WavFormat_t& fmt);
     void skipToDataChunk();
+    template <int BYTES, bool FUSE_VOLUME>
+    void decodeFrames(int32_t* samples, const uint8_t* buf, uint32_t numFrames, int32_t volMul);
     bool parseSetPos(size_t fpos);
     void decode();
+    void decodeCrossfade(int32_t* samples, uint32_t numFrames);
+    void finishCrossfade();
+    void abortCrossfade();
 };
@@ -9,102 +9,125 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <new>
 
+#include "diskio.h"
+#include "io_service.h"
 #include "pico/flash.h"
 #include "pico/multicore.h"
+#include "pico/stdlib.h"
+#include "tf_card.h"
 
-ReadBuffer* ReadBuffer::_inst = nullptr;
+ReadBuffer* volatile ReadBuffer::_inst[NUM_STREAMS] = {};
+uint16_t ReadBuffer::_latencyHist[NUM_LATENCY_BINS] = {};
+uint16_t ReadBuffer::_latencyCount = 0;
+volatile uint32_t ReadBuffer::_latencyMs = 64;  // conservative until measured
+volatile ReadBuffer::FillPolicy_t ReadBuffer::_policy = ReadBuffer::LatencyFirst;
+uint64_t ReadBuffer::_activeUs = 0;
+uint32_t ReadBuffer::_errorCount[FR_INVALID_PARAMETER + 1] = {};
+uint32_t ReadBuffer::_retryCount = 0;
+uint32_t ReadBuffer::_giveUpCount = 0;
 
 void readBufferCore1Process()
 {
     flash_safe_execute_core_init();  // no access to flash on core1
-    ReadBuffer::getInstance()->fillLoop();
+    ReadBuffer::fillLoop();
     printf("ERROR: ReadBuffer::fillLoop() exit\r\n");
 }
 
-ReadBuffer* ReadBuffer::getInstance()
+ReadBuffer* ReadBuffer::getInstance(int id)
 {
-    if (_inst == nullptr) {
-        // create Singleton instance
-        _inst = new ReadBuffer();
-        // start process on core1
-        multicore_reset_core1();
-        multicore_launch_core1(readBufferCore1Process);
+    if (id < 0 || id >= NUM_STREAMS) { return nullptr; }
+    if (_inst[id] == nullptr) {
+        // create Singleton instance (published to core1 after construction)
+        ReadBuffer* inst = new (std::nothrow) ReadBuffer();
+        if (inst == nullptr) { return nullptr; }
+        __dmb();
+        _inst[id] = inst;
+        if (id == 0) {
+            // start process on core1
+            multicore_reset_core1();
+            multicore_launch_core1(readBufferCore1Process);
+        }
     }
-    return _inst;
+    return _inst[id];
 }
 
-// fillThreshold: auto fill if left is lower than fillThreshold
-//                set fillThreshold = 0 if using manual fill instead of auto fill
-//                set fillThreshold = size if auto fill everytime when shift (not recommended due to too many memmove)
 ReadBuffer::ReadBuffer() :
-    _size(PlayAudio::RDBUF_SIZE), _left(0), _fillThreshold(PlayAudio::RDBUF_THRESHOLD), _isEof(false)
+    _bindPending(false), _bindFlag(false), _fp(nullptr), _bindPos(0), _headBytes(0), _lba(0), _eodPos(0), _isEod(true), _wrBytes(0), _rdBytes(0), _filling(false),
+    _bursting(false), _bindTime(0), _bitRateKbps(44100*16*2/1000), _readBytes(0), _readUs(0), _retry(0), _retryUs(0)
 {
-    _head = reinterpret_cast<uint8_t*>(calloc(_size, sizeof(uint8_t)));
-    _ptr = _head;
+    queue_init(&bindReqQueue, sizeof(bindReq_t), 1);
+    queue_init(&bindRespQueue, sizeof(bindReq_t), 1);
 }
 
 ReadBuffer::~ReadBuffer()
 {
-    free(_head);
 }
 
 const uint8_t* ReadBuffer::buf()
 {
-    return reinterpret_cast<const uint8_t*>(_ptr);
+    return &_ring[_rdBytes % RING_SIZE];
 }
 
-void ReadBuffer::bind(FIL* fp)
+void ReadBuffer::bind(FIL* fp, size_t eodPos)
 {
     _fp = fp;
-    _ptr = _head;
-    _left = 0;
-    _isEof = false;
-    _eodPos = f_size(_fp);
-    _isEod = false;
-}
-
-bool ReadBuffer::fill()
-{
-    if (_isEof) { return false; }
-    if (queue_is_empty(&secondaryBufferQueue)) {
-        // insert zeros to avoid blank noise
-        memmove(_head, _ptr, _left);
-        _ptr = _head;
-        size_t space = _size - _left;
-        memset(_head + _left, 0, space);
-        _left += space;
-        printf("ERROR: ReadBuffer::secondaryBuffer is empty\r\n");
-        return false;
-    }
-    secondaryBufferItem_t item;
-    queue_peek_blocking(&secondaryBufferQueue, &item);  // not remove here to preend from overwrite by new data
-    memmove(_head, _ptr, _left);
-    _ptr = _head;
-    size_t space = _size - _left;
-    memcpy(_head + _left, item.ptr, item.length);
-    queue_remove_blocking(&secondaryBufferQueue, &item);  // remove from queue here actually
-    _pos = item.pos;
-    _left += item.length;
-    _isEof = item.reachedEof;
-    if (space > item.length) {
-        memset(_head + _left, 0, space - item.length);  // fill 0
+    // locate ring offset same as the offset in chunk so that reads after the first one are chunk aligned
+    size_t pos = f_tell(_fp);
+    _bindPos = pos & ~(CHUNK_SIZE - 1);
+    _eodPos = (eodPos > 0 && eodPos < f_size(_fp)) ? eodPos : f_size(_fp);
+    _isEod = static_cast<bool>(f_eof(_fp)) || pos >= _eodPos;
+    _wrBytes = pos - _bindPos;
+    _rdBytes = _wrBytes;
+    _headBytes = _wrBytes;
+    _readBytes = 0;
+    _readUs = 0;
+    _bindTime = time_us_32();
+    _bursting = false;
+    _retry = 0;
+    // contiguous file can be streamed by raw sectors without FAT lookup
+    bool contiguous = false;
+    contiguous |= (_fp->cltbl != nullptr && _fp->cltbl[0] == 4);  // link map of single fragment
+    #if FF_FS_EXFAT
+    contiguous |= (_fp->obj.fs->fs_type == FS_EXFAT && _fp->obj.stat == 2);  // NoFatChain
+    #endif // FF_FS_EXFAT
+    FATFS* fs = _fp->obj.fs;
+    _lba = (contiguous && _fp->obj.sclust >= 2) ? fs->database + static_cast<LBA_t>(fs->csize) * (_fp->obj.sclust - 2) : 0;
+}
+
+// read sectors of contiguous file directly by disk_read (core1)
+// pos must be sector aligned, and the tail of the last sector beyond btr is also written to buff
+FRESULT ReadBuffer::readRaw(size_t pos, uint8_t* buff, UINT btr, UINT* br)
+{
+    UINT count = (btr + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    if (disk_read(_fp->obj.fs->pdrv, buff, _lba + pos / SECTOR_SIZE, count) != RES_OK) {
+        *br = 0;
+        return FR_DISK_ERR;
     }
-    return true;
+    *br = btr;
+    return FR_OK;
+}
+
+size_t ReadBuffer::getUsed()
+{
+    return _wrBytes - _rdBytes;
 }
 
 bool ReadBuffer::shift(size_t bytes)
 {
-    if (_left < bytes) { return false; }
-    _ptr += bytes;
-    _left -= bytes;
-    if (_left < _fillThreshold) { fill(); }
+    if (getLeft() < bytes) { return false; }
+    __dmb();  // finish reading before releasing the area to core1
+    size_t rdBytes = _rdBytes;
+    _rdBytes = rdBytes + bytes;
+    // wake core1 only when a whole chunk gets free
+    if ((rdBytes + bytes) / CHUNK_SIZE != rdBytes / CHUNK_SIZE) { __sev(); }
     return true;
 }
 
 bool ReadBuffer::shiftAll()
 {
-    return shift(_left);
+    return shift(getLeft());
 }
 
 void ReadBuffer::setEodPos(size_t pos)
@@ -117,116 +140,396 @@ bool ReadBuffer::seek(size_t pos)
 {
     if (pos >= f_size(_fp)) { return false; }
     if (pos >= _eodPos) { return false; }
-    size_t eodPos = _eodPos;
-    reqBind(_fp, false);  // disconnect secondaryBuffer (dispose current secondaryBuffer)
-    f_lseek(_fp, pos);   // seek (move reading point)
-    reqBind(_fp);         // reconnect
-    _eodPos = eodPos;
+    // target inside the data in ring: only move read pointer
+    size_t cur = tell();
+    if (pos >= cur && pos < _bindPos + _wrBytes) { return shift(pos - cur); }
+    if (pos < cur && reqRewind(pos)) { return true; }
+    FIL* fp = _fp;
+    reqBind(fp, false);  // disconnect ring (dispose current data)
+    io_f_lseek(IO_REQ_AUDIO, fp, pos);  // seek (move reading point)
+    // reconnect and return as soon as the first chunk arrives, then read-ahead continues on core1
+    reqBindAsync(fp, true, _eodPos);
+    while (!isBindDone()) {
+        if (!_bindPending && (_wrBytes >= CHUNK_SIZE || _isEod)) { break; }
+        __wfe();
+    }
+    return true;
+}
+
+// move read pointer back within the data remaining in ring (core1)
+// core1 is not writing at this moment, so every byte in the last RING_SIZE bytes is valid
+bool ReadBuffer::rewind(size_t pos)
+{
+    if (pos < _bindPos) { return false; }
+    size_t target = pos - _bindPos;
+    size_t oldest = (_wrBytes > RING_SIZE) ? _wrBytes - RING_SIZE : 0;
+    if (oldest < _headBytes) { oldest = _headBytes; }
+    if (target < oldest || target > _rdBytes) { return false; }
+    _rdBytes = target;
     return true;
 }
 
+bool ReadBuffer::reqRewind(size_t pos)
+{
+    bindReq_t req = {REQ_REWIND, _fp, pos, false};
+    // request slot is taken by bind in flight: caller falls back to re-bind
+    if (_bindPending || !queue_try_add(&bindReqQueue, &req)) { return false; }
+    __sev();
+    queue_remove_blocking(&bindRespQueue, &req);
+    return req.result;
+}
+
 size_t ReadBuffer::getLeft()
 {
-    return _left;
+    // data read beyond end of data (e.g. trailing chunks of WAV) is not exposed
+    size_t wrBytes = _wrBytes;
+    size_t eodBytes = (_eodPos > _bindPos) ? _eodPos - _bindPos : 0;
+    if (wrBytes > eodBytes) { wrBytes = eodBytes; }
+    return (wrBytes > _rdBytes) ? wrBytes - _rdBytes : 0;
+}
+
+size_t ReadBuffer::getContiguous()
+{
+    size_t contiguous = RING_SIZE + MIRROR_SIZE - _rdBytes % RING_SIZE;
+    size_t left = getLeft();
+    return (left < contiguous) ? left : contiguous;
 }
 
 size_t ReadBuffer::tell()
 {
-    return _pos - _left;
+    return _bindPos + _rdBytes;
 }
 
 bool ReadBuffer::isFull()
 {
-    return queue_is_full(&secondaryBufferQueue);
+    return _isEod || !needsFill();
 }
 
 bool ReadBuffer::isNearEmpty()
 {
-    return (!_isEod && queue_get_level(&secondaryBufferQueue) <= NUM_SECONDARY_BUFFERS / 4);
+    // less than half of the cushion means a read of worst latency cannot catch up
+    return (!_isEod && getUsed() < getCushionBytes() / 2);
+}
+
+bool ReadBuffer::isBound()
+{
+    return _fp != nullptr;
+}
+
+bool ReadBuffer::reachedEod()
+{
+    return _isEod;
+}
+
+bool ReadBuffer::isContiguous()
+{
+    return _lba != 0;
+}
+
+void ReadBuffer::setBitRate(uint16_t kbps)
+{
+    _bitRateKbps = kbps;
+    __sev();  // cushion may have grown
+}
+
+// audio bytes to keep in the ring to survive the read latency of the card
+size_t ReadBuffer::getCushionBytes()
+{
+    size_t bytesPerMs = _bitRateKbps / 8;
+    size_t cushion = bytesPerMs * (_latencyMs * 2 + MARGIN_MS);
+    cushion = (cushion + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1);
+    if (cushion < CHUNK_SIZE * 2) { cushion = CHUNK_SIZE * 2; }
+    if (cushion > RING_SIZE - CHUNK_SIZE * 2) { cushion = RING_SIZE - CHUNK_SIZE * 2; }
+    return cushion;
+}
+
+// read in batch of half the space above the cushion (at least a chunk) for efficiency
+size_t ReadBuffer::getBatchBytes(size_t cushion)
+{
+    size_t batch = ((RING_SIZE - cushion) / 2) & ~(CHUNK_SIZE - 1);
+    return (batch > CHUNK_SIZE) ? batch : CHUNK_SIZE;
+}
+
+// fill when batch of space is free, or earlier if data goes below the cushion (e.g. latency spike)
+bool ReadBuffer::needsFill()
+{
+    size_t used = getUsed();
+    size_t space = RING_SIZE - used;
+    if (space < CHUNK_SIZE) { return false; }
+    size_t cushion = getCushionBytes();
+    if (_policy == PowerFirst) {
+        return _bursting || used < cushion;
+    }
+    return space >= getBatchBytes(cushion) || used < cushion;
+}
+
+void ReadBuffer::setFillPolicy(FillPolicy_t policy)
+{
+    _policy = policy;
+    __sev();
+}
+
+ReadBuffer::FillPolicy_t ReadBuffer::getFillPolicy()
+{
+    return _policy;
+}
+
+uint32_t ReadBuffer::getCardActiveMs()
+{
+    return static_cast<uint32_t>(_activeUs / 1000);
+}
+
+uint32_t ReadBuffer::getDutyPermil()
+{
+    uint32_t elapsed = time_us_32() - _bindTime;
+    if (elapsed == 0) { return 0; }
+    return static_cast<uint32_t>(static_cast<uint64_t>(_readUs) * 1000 / elapsed);
+}
+
+uint32_t ReadBuffer::getLatencyMs()
+{
+    return _latencyMs;
+}
+
+const uint16_t* ReadBuffer::getLatencyHistogram()
+{
+    return _latencyHist;
+}
+
+// running histogram of read latency in log2 ms (core1)
+void ReadBuffer::recordLatency(uint32_t us)
+{
+    uint32_t ms = us / 1000;
+    int bin = 0;
+    while (ms > 0 && bin < NUM_LATENCY_BINS - 1) {
+        ms >>= 1;
+        bin++;
+    }
+    _latencyHist[bin]++;
+    if (++_latencyCount >= LATENCY_WINDOW) {  // decay to follow recent behavior
+        _latencyCount = 0;
+        for (auto& h : _latencyHist) {
+            h /= 2;
+            _latencyCount += h;
+        }
+    }
+    // 99 percentile
+    uint32_t total = 0;
+    for (const auto& h : _latencyHist) { total += h; }
+    uint32_t cumulative = 0;
+    for (int i = 0; i < NUM_LATENCY_BINS; i++) {
+        cumulative += _latencyHist[i];
+        if (cumulative * 100 >= total * 99) {
+            _latencyMs = 1UL << i;
+            break;
+        }
+    }
+}
+
+uint32_t ReadBuffer::getThroughputKBps()
+{
+    if (_readUs == 0) { return 0; }
+    return static_cast<uint32_t>(static_cast<uint64_t>(_readBytes) * 1000 / 1024 * 1000 / _readUs);
 }
 
 void ReadBuffer::reqBind(FIL* fp, bool flag)
 {
-    bindReq_t req = {fp, flag};
-    // send request
+    reqBindAsync(fp, flag);
+    while (!isBindDone()) { __wfe(); }
+}
+
+// send request to core1 and return immediately, then poll isBindDone()
+void ReadBuffer::reqBindAsync(FIL* fp, bool flag, size_t eodPos)
+{
+    bindReq_t req = {flag ? REQ_BIND : REQ_UNBIND, fp, eodPos, false};
+    _bindPending = true;
+    _bindFlag = flag;
     queue_try_add(&bindReqQueue, &req);
-    // wait response
-    queue_remove_blocking(&bindRespQueue, &req);
-    if (flag) {
-        while (!queue_is_full(&secondaryBufferQueue)) {}
-        fill();
+    __sev();
+}
+
+// bind is done when core1 responded and (in case of bind) the ring is filled
+bool ReadBuffer::isBindDone()
+{
+    if (_bindPending) {
+        bindReq_t req;
+        if (!queue_try_remove(&bindRespQueue, &req)) { return false; }
+        _bindPending = false;
+        if (!_bindFlag) { _fp = nullptr; }
     }
+    return !_bindFlag || !_filling || isFull();
 }
 
-void ReadBuffer::fillLoop()
+// accept reqBind() (core1)
+void ReadBuffer::serviceReq()
 {
-    int id = 0;
-    FIL* fp;
-    queue_init(&bindReqQueue, sizeof(bindReq_t), 1);
-    queue_init(&bindRespQueue, sizeof(bindReq_t), 1);
-    queue_init(&secondaryBufferQueue, sizeof(secondaryBufferItem_t), NUM_SECONDARY_BUFFERS);
     bindReq_t req;
-    secondaryBufferItem_t item;
+    if (!queue_try_remove(&bindReqQueue, &req)) { return; }
+    switch (req.cmd) {
+        case REQ_BIND:
+            if (!_filling) {  // ignore reqBind(true) while filling
+                bind(req.fp, req.pos);
+                _filling = !_isEod;
+            }
+            break;
+        case REQ_UNBIND:
+            // dispose all data in ring
+            _filling = false;
+            _rdBytes = _wrBytes;
+            break;
+        case REQ_REWIND:
+            req.result = rewind(req.pos);
+            break;
+        default:
+            break;
+    }
+    queue_try_add(&bindRespQueue, &req);  // response regardless of command
+    __sev();
+}
 
-    while (true) {
-        // expecting reqBind(true)
-        while (queue_is_empty(&bindReqQueue)) {}
-        queue_remove_blocking(&bindReqQueue, &req);
-        if (req.flag) {
-            fp = req.fp;
-            bind(fp);
-            item.pos = f_tell(fp);
-            item.reachedEof = _isEod || static_cast<bool>(f_eof(fp));
+// read rebooting SPI before retry (core1, io_service lock held)
+// on failure the next retry is scheduled after a wait, which fillOnce() spends out of the lock
+FRESULT ReadBuffer::readWithRetry(size_t pos, uint8_t* buff, UINT btr, UINT* br)
+{
+    FRESULT fr = FR_OK;
+    *br = 0;
+    if (_retry > 0) {
+        _retryCount++;
+        pico_fatfs_reboot_spi();
+        // FIL::err is FatFs internal (R0.15): it keeps hard error and rejects any further access to the file
+        _fp->err = 0;
+        fr = f_lseek(_fp, pos);
+    }
+    if (fr == FR_OK) {
+        // the first read after bind is not sector aligned, then it goes through f_read
+        // (the tail of the last sector fits in the ring because the end of read is chunk aligned)
+        if (_lba != 0 && (pos & (SECTOR_SIZE - 1)) == 0) {
+            fr = readRaw(pos, buff, btr, br);
+        } else {
+            fr = f_read(_fp, buff, btr, br);
+            if (fr == FR_OK && *br == 0 && !f_eof(_fp)) { fr = FR_INT_ERR; }  // no progress
         }
-        queue_try_add(&bindRespQueue, &req);  // response regardless of flag
-        if (!req.flag) { continue; }  // retry if reqBind(false)
-
-        while (!item.reachedEof) {
-            // read from file to store secondaryBuffer
-            while (!queue_is_full(&secondaryBufferQueue)) {
-                // read at once for max efficiency as min of either till the end of buffer or spare number of queue
-                int level = static_cast<int>(queue_get_level(&secondaryBufferQueue));
-                int reqN = NUM_SECONDARY_BUFFERS - ((id > level) ? id : level);
-                UINT reqBr;
-                if (item.pos + SECONDARY_BUFFER_SIZE * reqN >= _eodPos) {
-                    reqBr = _eodPos - item.pos;
-                    _isEod = true;
-                } else {
-                    reqBr = SECONDARY_BUFFER_SIZE * reqN;
-                }
-                UINT br;
-                FRESULT fr = f_read(fp, &secondaryBuffer[SECONDARY_BUFFER_SIZE * id], reqBr, &br);
-                _isEod |= static_cast<bool>(f_eof(fp));
-                if (fr != FR_OK || br == 0) { return; }
-                // put on queue divided by SECONDARY_BUFFER_SIZE
-                int readN = (br + SECONDARY_BUFFER_SIZE - 1) / SECONDARY_BUFFER_SIZE;
-                for (int i = 0; i < readN; i++) {
-                    if (i < readN - 1) {
-                        item.length = SECONDARY_BUFFER_SIZE;
-                        item.reachedEof = false;
-                    } else {
-                        item.length = br - SECONDARY_BUFFER_SIZE * i;
-                        item.reachedEof = _isEod;
-                    }
-                    item.ptr = &secondaryBuffer[SECONDARY_BUFFER_SIZE * id];
-                    item.pos += item.length;
-                    queue_try_add(&secondaryBufferQueue, &item);
-                    id = (id + 1) % NUM_SECONDARY_BUFFERS;
-                }
-                if (item.reachedEof) { break; }
-            }
-            // acceptance of reqBind(false)
-            if (!queue_is_empty(&bindReqQueue)) {
-                queue_remove_blocking(&bindReqQueue, &req);
-                if (!req.flag) {
-                    // discard all data in senondaryBufferQueue
-                    while (!queue_is_empty(&secondaryBufferQueue)) {
-                        queue_remove_blocking(&secondaryBufferQueue, &item);
-                    }
-                }
-                queue_try_add(&bindRespQueue, &req);  // response regardless of flag
-                if (!req.flag) { break; }  // start over if reqBind(false), otherwise ignore
+    }
+    if (fr == FR_OK) {
+        _retry = 0;
+        return fr;
+    }
+    _errorCount[fr]++;
+    if (_retry++ < MAX_RETRIES) {
+        _retryUs = time_us_32() + RETRY_WAIT_MS * 1000 * _retry;
+    } else {
+        _giveUpCount++;
+    }
+    return fr;
+}
+
+uint32_t ReadBuffer::getErrorCount()
+{
+    uint32_t total = 0;
+    for (const auto& count : _errorCount) { total += count; }
+    return total;
+}
+
+void ReadBuffer::printErrorStats()
+{
+    for (int i = 0; i <= FR_INVALID_PARAMETER; i++) {
+        if (_errorCount[i] == 0) { continue; }
+        printf("ReadBuffer::error %d: %d times\r\n", i, static_cast<int>(_errorCount[i]));
+    }
+    printf("ReadBuffer::retry %d times, give up %d times\r\n", static_cast<int>(_retryCount), static_cast<int>(_giveUpCount));
+}
+
+// read from file directly into ring (core1)
+// return false if FatFs is busy with core0, then retry after core0 releases it
+bool ReadBuffer::fillOnce(size_t maxChunks)
+{
+    // read at once for max efficiency as min of either till the end of ring or spare space
+    // the end of read is always aligned to CHUNK_SIZE except for the last read before end of data
+    size_t wrOfs = _wrBytes % RING_SIZE;
+    size_t limit = RING_SIZE - getUsed();
+    if (limit > RING_SIZE - wrOfs) { limit = RING_SIZE - wrOfs; }
+    if (limit > CHUNK_SIZE * maxChunks) { limit = CHUNK_SIZE * maxChunks; }
+    size_t end = (_wrBytes + limit) & ~(CHUNK_SIZE - 1);
+    if (end <= _wrBytes) { return true; }
+    size_t pos = _bindPos + _wrBytes;
+    UINT reqBr;
+    bool isEod = false;
+    if (_bindPos + end >= _eodPos) {
+        reqBr = (_eodPos > pos) ? _eodPos - pos : 0;
+        isEod = true;
+    } else {
+        reqBr = end - _wrBytes;
+    }
+    // wait before retry without the lock, meanwhile fillLoop() keeps serving bind requests and the other stream
+    if (_retry > 0 && static_cast<int32_t>(time_us_32() - _retryUs) < 0) { return true; }
+    // never block core1 for FatFs not to delay bind requests from core0 (possibly in IRQ) behind core0 itself
+    if (!io_try_lock(IO_REQ_AUDIO)) { return false; }
+    UINT br = 0;
+    uint32_t t0 = time_us_32();
+    FRESULT fr = (reqBr > 0) ? readWithRetry(pos, &_ring[wrOfs], reqBr, &br) : FR_OK;
+    if (_lba == 0) { isEod |= static_cast<bool>(f_eof(_fp)); }
+    io_unlock(IO_REQ_AUDIO);
+    uint32_t t = time_us_32() - t0;
+    _readUs += t;
+    _readBytes += br;
+    _activeUs += t;
+    recordLatency(t);
+    if (fr != FR_OK && _retry <= MAX_RETRIES) { return true; }  // nothing taken, read again after the wait
+    if (fr != FR_OK) {
+        // end the track gracefully with the data read so far
+        printf("ERROR: ReadBuffer::read %d, give up the stream\r\n", static_cast<int>(fr));
+        isEod = true;
+    }
+    // mirror the head of ring after its end
+    if (wrOfs < MIRROR_SIZE) {
+        size_t len = (br < MIRROR_SIZE - wrOfs) ? br : MIRROR_SIZE - wrOfs;
+        memcpy(&_ring[RING_SIZE + wrOfs], &_ring[wrOfs], len);
+    }
+    __dmb();  // publish data before counter
+    _wrBytes = _wrBytes + br;
+    if (isEod) {
+        _isEod = true;
+        _filling = false;
+    }
+    if (RING_SIZE - getUsed() < CHUNK_SIZE) { _bursting = false; }  // burst completes when the ring is full
+    __sev();  // notify core0 waiting for bind
+    return true;
+}
+
+// service all streams on core1, giving read priority to the stream closest to running dry
+void ReadBuffer::fillLoop()
+{
+    while (true) {
+        ReadBuffer* target = nullptr;
+        int32_t minMargin = INT32_MAX;
+        int numFilling = 0;
+        for (int i = 0; i < NUM_STREAMS; i++) {
+            ReadBuffer* inst = _inst[i];
+            if (inst == nullptr) { continue; }
+            inst->serviceReq();
+            if (!inst->_filling) { continue; }
+            numFilling++;
+            if (!inst->needsFill()) { continue; }
+            // the stream with least data above its cushion first
+            int32_t margin = static_cast<int32_t>(inst->getUsed()) - static_cast<int32_t>(inst->getCushionBytes());
+            if (margin < minMargin) {
+                minMargin = margin;
+                target = inst;
             }
         }
+        if (target == nullptr) {
+            io_cancel(IO_REQ_AUDIO);  // withdraw priority claim left by io_try_lock()
+            // e.g. directory sort, bind requests and streams are serviced again between its steps
+            if (io_run_idle_task(numFilling == 0)) { continue; }
+            // sleep until request arrives or decoder frees a chunk
+            // (event flagged by __sev() in between is latched, then __wfe() returns immediately)
+            __wfe();
+            continue;
+        }
+        if (_policy == PowerFirst) { target->_bursting = true; }
+        // split reads while plural streams are active not to starve the other
+        if (!target->fillOnce((numFilling > 1) ? NUM_CHUNKS / 4 : NUM_CHUNKS)) {
+            __wfe();  // woken by io_unlock()
+        }
     }
 }
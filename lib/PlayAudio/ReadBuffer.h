@@ -14,52 +14,120 @@
 //=================================
 // Interface of ReadBuffer Class
 //=================================
+// core1 reads file directly into a ring buffer and decoder on core0 refers to the ring without copy.
+// The head of ring is mirrored after its end so that a block straddling the end of ring stays contiguous.
+// core1 sleeps by __wfe() while there is nothing to do, and both cores wake the other by __sev()
 class ReadBuffer
 {
 public:
-    static ReadBuffer* getInstance();  // Singleton
+    static constexpr int NUM_STREAMS = 2;  // 0: main stream, 1: crossfade stream
+    static ReadBuffer* getInstance(int id = 0);  // Singleton per stream (nullptr if no memory)
     ReadBuffer();
     virtual ~ReadBuffer();
+    typedef enum {
+        LatencyFirst = 0,  // keep the ring full by reading as soon as batch of space is free
+        PowerFirst,        // let the card idle till the cushion, then refill the whole ring in a burst
+    } FillPolicy_t;
+    static void setFillPolicy(FillPolicy_t policy);
+    static FillPolicy_t getFillPolicy();
+    static uint32_t getCardActiveMs();  // accumulated time of reading from the card
+    static constexpr int NUM_LATENCY_BINS = 10;  // [0]: < 1 ms, [i]: < 2^i ms, [9]: >= 256 ms
+    static uint32_t getLatencyMs();  // 99 percentile of recent read latency (upper bound of the bin)
+    static const uint16_t* getLatencyHistogram();
+    static uint32_t getErrorCount();  // total of read errors including recovered ones
+    static void printErrorStats();
     void reqBind(FIL* fp, bool flag = true);
+    void reqBindAsync(FIL* fp, bool flag = true, size_t eodPos = 0);
+    bool isBindDone();
     const uint8_t* buf();
     bool shift(size_t bytes);
     bool shiftAll();
     void setEodPos(size_t pos);
     bool seek(size_t pos);
     size_t getLeft();
+    size_t getContiguous();  // bytes accessible from buf() at once
     size_t tell();
-    bool isFull();
+    bool isFull();  // no need to fill for now
     bool isNearEmpty();
+    bool isBound();
+    bool reachedEod();
+    bool isContiguous();
+    uint32_t getThroughputKBps();  // average of f_read since last bind
+    uint32_t getDutyPermil();  // card active time over elapsed time since last bind
+    void setBitRate(uint16_t kbps);
+    size_t getCushionBytes();
 private:
-    static constexpr size_t SECONDARY_BUFFER_SIZE = PlayAudio::RDBUF_SIZE - PlayAudio::RDBUF_THRESHOLD;
-    static constexpr size_t NUM_SECONDARY_BUFFERS = 8;
-    static ReadBuffer* _inst;  // Singleton instance
-    uint8_t secondaryBuffer[SECONDARY_BUFFER_SIZE * NUM_SECONDARY_BUFFERS];
-    typedef struct _secondaryBufferItem_t {
-        uint8_t* ptr;
-        size_t   pos;
-        size_t   length;
-        bool     reachedEof;
-    } secondaryBufferItem_t;
+    // chunk is multiple of sector (and power of 2) so that every read except the first one after bind
+    // starts at sector boundary of the file, then FatFs transfers whole sectors directly into the ring
+    // by multi-block read instead of through its sector window
+    static constexpr size_t SECTOR_SIZE = 512;
+    static constexpr size_t CHUNK_SIZE = SECTOR_SIZE * 8;
+    #if PICO_RP2350
+    static constexpr size_t NUM_CHUNKS = 24;  // longer bursts with larger RAM
+    #else
+    static constexpr size_t NUM_CHUNKS = 12;
+    #endif
+    static constexpr size_t RING_SIZE = CHUNK_SIZE * NUM_CHUNKS;
+    static constexpr size_t MIRROR_SIZE = 64;  // must cover max block bytes
+    static_assert((CHUNK_SIZE & (CHUNK_SIZE - 1)) == 0, "CHUNK_SIZE must be power of 2");
+    static constexpr int MAX_RETRIES = 3;  // give up the stream (end of track) after this
+    static constexpr uint32_t RETRY_WAIT_MS = 10;  // multiplied by retry count
+    static constexpr uint32_t MARGIN_MS = 20;  // decode and scheduling margin on top of read latency
+    static constexpr uint16_t LATENCY_WINDOW = 256;  // histogram is halved every this many reads
+    static uint16_t _latencyHist[NUM_LATENCY_BINS];
+    static uint16_t _latencyCount;
+    static volatile uint32_t _latencyMs;
+    static volatile FillPolicy_t _policy;
+    static uint64_t _activeUs;
+    static uint32_t _errorCount[FR_INVALID_PARAMETER + 1];  // by FRESULT
+    static uint32_t _retryCount;
+    static uint32_t _giveUpCount;
+    static ReadBuffer* volatile _inst[NUM_STREAMS];  // Singleton instances
+    alignas(4) uint8_t _ring[RING_SIZE + MIRROR_SIZE];
+    typedef enum {
+        REQ_UNBIND = 0,
+        REQ_BIND,
+        REQ_REWIND
+    } reqCmd_t;
     typedef struct _bindReq_t {
+        reqCmd_t cmd;
         FIL* fp;
-        bool flag;
+        size_t pos;  // REQ_BIND: end of data (0: file size), REQ_REWIND: target file position
+        bool result;
     } bindReq_t;
-    queue_t secondaryBufferQueue;
     queue_t bindReqQueue;
     queue_t bindRespQueue;
+    bool _bindPending;
+    bool _bindFlag;
     FIL* _fp;
-    size_t _size;
-    size_t _pos;
-    size_t _left;
+    size_t _bindPos;  // chunk aligned file position corresponding to ring offset 0
+    size_t _headBytes;  // offset of the first valid data in ring since bind
+    LBA_t _lba;  // start sector of the file if it is contiguous (0: use f_read)
     size_t _eodPos;
-    bool _isEod;
-    uint8_t* _head;
-    uint8_t* _ptr;
-    size_t _fillThreshold;
-    bool _isEof;
-    void bind(FIL* fp);
-    bool fill();
-    void fillLoop();
+    volatile bool _isEod;
+    volatile size_t _wrBytes;  // written by core1 since bind
+    volatile size_t _rdBytes;  // consumed by core0 since bind
+    // core1 side
+    volatile bool _filling;
+    volatile bool _bursting;  // refilling in a burst (PowerFirst)
+    uint32_t _bindTime;
+    volatile uint16_t _bitRateKbps;
+    uint32_t _readBytes;
+    uint32_t _readUs;
+    int _retry;  // retries done for the current read (MAX_RETRIES + 1: gave up)
+    uint32_t _retryUs;  // time to retry at
+    void bind(FIL* fp, size_t eodPos);
+    bool rewind(size_t pos);
+    bool reqRewind(size_t pos);
+    FRESULT readRaw(size_t pos, uint8_t* buff, UINT btr, UINT* br);
+    FRESULT readWithRetry(size_t pos, uint8_t* buff, UINT btr, UINT* br);
+    size_t getUsed();
+    size_t getBatchBytes(size_t cushion);
+    bool needsFill();
+    static void recordLatency(uint32_t us);
+    void serviceReq();
+    bool fillOnce(size_t maxChunks);
+    static void fillLoop();
     friend void readBufferCore1Process();
+    friend class ReadBufferTest;  // host unit test (tests/test_read_buffer.cpp) plays core1 side
 };
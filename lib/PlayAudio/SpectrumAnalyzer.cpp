@@ -0,0 +1,190 @@
+/*------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/------------------------------------------------------*/
+
+#include "SpectrumAnalyzer.h"
+
+#include <cmath>
+
+#include "pico/stdlib.h"
+
+int16_t SpectrumAnalyzer::tap[TAP_SIZE] = {};
+volatile uint32_t SpectrumAnalyzer::tapWrIdx = 0;
+int32_t SpectrumAnalyzer::decimAccum = 0;
+uint32_t SpectrumAnalyzer::decimCount = 0;
+uint32_t SpectrumAnalyzer::decimShift = 0;
+bool SpectrumAnalyzer::enabled = false;
+int16_t SpectrumAnalyzer::cosTable[FFT_SIZE];
+int16_t SpectrumAnalyzer::sinTable[FFT_SIZE];
+int16_t SpectrumAnalyzer::window[FFT_SIZE];
+uint8_t SpectrumAnalyzer::revTable[FFT_SIZE];
+uint16_t SpectrumAnalyzer::bandEdge[MAX_BANDS + 1];
+int SpectrumAnalyzer::numBandEdges = 0;
+float SpectrumAnalyzer::bandLevel[MAX_BANDS] = {};
+uint32_t SpectrumAnalyzer::costUs = 0;
+uint32_t SpectrumAnalyzer::maxCostUs = 0;
+uint32_t SpectrumAnalyzer::skipCount = 0;
+
+void SpectrumAnalyzer::initialize()
+{
+    const float Pi = 3.14159265f;
+    for (int i = 0; i < FFT_SIZE; i++) {
+        cosTable[i] = static_cast<int16_t>(lrintf(32767.0f * cosf(2.0f * Pi * i / FFT_SIZE)));
+        sinTable[i] = static_cast<int16_t>(lrintf(32767.0f * sinf(2.0f * Pi * i / FFT_SIZE)));
+        window[i] = static_cast<int16_t>(lrintf(32767.0f * (0.5f - 0.5f * cosf(2.0f * Pi * i / FFT_SIZE))));  // Hann
+        // base-4 digit reversal
+        int rev = 0;
+        for (int n = i, k = 1; k < FFT_SIZE; n >>= 2, k <<= 2) {
+            rev = (rev << 2) | (n & 0x3);
+        }
+        revTable[i] = static_cast<uint8_t>(rev);
+    }
+}
+
+void SpectrumAnalyzer::setEnabled(bool flag)
+{
+    enabled = flag;
+}
+
+bool SpectrumAnalyzer::isEnabled()
+{
+    return enabled;
+}
+
+void SpectrumAnalyzer::setSampFreq(uint32_t sampFreq)
+{
+    // decimate to 44.1 KHz / 48 KHz range so that bands always cover audible range
+    uint32_t shift = 0;
+    while ((sampFreq >> (shift + 1)) >= 44100) { shift++; }
+    decimShift = shift;
+    decimAccum = 0;
+    decimCount = 0;
+}
+
+void SpectrumAnalyzer::setupBands(int numBands)
+{
+    // logarithmically spaced band edges over FFT bins 1 ~ FFT_SIZE/2
+    const float lastBin = static_cast<float>(FFT_SIZE / 2);
+    bandEdge[0] = 1;
+    for (int i = 1; i <= numBands; i++) {
+        uint16_t edge = static_cast<uint16_t>(lrintf(powf(lastBin, static_cast<float>(i) / numBands)));
+        bandEdge[i] = (edge > bandEdge[i-1]) ? edge : bandEdge[i-1] + 1;
+    }
+    // pull back edges from the top if the lowest bands ran out of resolution
+    bandEdge[numBands] = FFT_SIZE / 2 + 1;
+    for (int i = numBands - 1; i > 0 && bandEdge[i] >= bandEdge[i+1]; i--) {
+        bandEdge[i] = bandEdge[i+1] - 1;
+    }
+    numBandEdges = numBands + 1;
+}
+
+void SpectrumAnalyzer::fft(int32_t* re, int32_t* im)
+{
+    // radix-4 decimation in frequency with 1/4 scaling at each stage (output in base-4 digit reversed order)
+    for (int n1 = FFT_SIZE, ie = 1; n1 > 1; n1 >>= 2, ie <<= 2) {
+        int n2 = n1 >> 2;
+        for (int j = 0; j < n2; j++) {
+            const int32_t c1 = cosTable[(j*ie) & (FFT_SIZE-1)];
+            const int32_t s1 = -sinTable[(j*ie) & (FFT_SIZE-1)];
+            const int32_t c2 = cosTable[(2*j*ie) & (FFT_SIZE-1)];
+            const int32_t s2 = -sinTable[(2*j*ie) & (FFT_SIZE-1)];
+            const int32_t c3 = cosTable[(3*j*ie) & (FFT_SIZE-1)];
+            const int32_t s3 = -sinTable[(3*j*ie) & (FFT_SIZE-1)];
+            for (int i = j; i < FFT_SIZE; i += n1) {
+                const int i1 = i + n2;
+                const int i2 = i1 + n2;
+                const int i3 = i2 + n2;
+                const int32_t t0r = (re[i] + re[i2]) >> 2;
+                const int32_t t0i = (im[i] + im[i2]) >> 2;
+                const int32_t t1r = (re[i] - re[i2]) >> 2;
+                const int32_t t1i = (im[i] - im[i2]) >> 2;
+                const int32_t t2r = (re[i1] + re[i3]) >> 2;
+                const int32_t t2i = (im[i1] + im[i3]) >> 2;
+                const int32_t t3r = (re[i1] - re[i3]) >> 2;
+                const int32_t t3i = (im[i1] - im[i3]) >> 2;
+                int32_t yr, yi;
+                re[i] = t0r + t2r;
+                im[i] = t0i + t2i;
+                yr = t1r + t3i; yi = t1i - t3r;  // X1 = t1 - j*t3
+                re[i1] = (yr * c1 - yi * s1) >> 15;
+                im[i1] = (yr * s1 + yi * c1) >> 15;
+                yr = t0r - t2r; yi = t0i - t2i;  // X2 = t0 - t2
+                re[i2] = (yr * c2 - yi * s2) >> 15;
+                im[i2] = (yr * s2 + yi * c2) >> 15;
+                yr = t1r - t3i; yi = t1i + t3r;  // X3 = t1 + j*t3
+                re[i3] = (yr * c3 - yi * s3) >> 15;
+                im[i3] = (yr * s3 + yi * c3) >> 15;
+            }
+        }
+    }
+}
+
+int32_t SpectrumAnalyzer::log2Q8(uint32_t value)
+{
+    // log2(value) * 256 by leading zero count and 4bit mantissa table of log2(1 + i/16) * 256
+    static const uint8_t mantissa[16] = {0, 22, 44, 63, 82, 100, 118, 134, 150, 165, 179, 193, 207, 220, 232, 244};
+    if (value == 0) { return 0; }
+    int msb = 31 - __builtin_clz(value);
+    uint32_t frac = (msb >= 4) ? (value >> (msb - 4)) & 0xf : (value << (4 - msb)) & 0xf;
+    return msb * 256 + mantissa[frac];
+}
+
+bool SpectrumAnalyzer::analyze(float* levels, int numBands)
+{
+    if (!enabled || numBands <= 0 || numBands > MAX_BANDS) { return false; }
+    if (skipCount > 0) {  // keep average cost under the budget
+        skipCount--;
+        return false;
+    }
+    uint32_t start = time_us_32();
+    if (numBandEdges != numBands + 1) { setupBands(numBands); }
+
+    // take snapshot of latest samples from tap without lock
+    int32_t re[FFT_SIZE];
+    int32_t im[FFT_SIZE];
+    uint32_t wrIdx = tapWrIdx;
+    if (wrIdx < FFT_SIZE) { return false; }
+    for (int i = 0; i < FFT_SIZE; i++) {
+        re[i] = (static_cast<int32_t>(tap[(wrIdx - FFT_SIZE + i) & (TAP_SIZE - 1)]) * window[i]) >> 15;
+        im[i] = 0;
+    }
+    if (tapWrIdx - wrIdx > TAP_SIZE - FFT_SIZE) { return false; }  // overwritten while copying
+
+    fft(re, im);
+
+    // band energy to level (0 dBFS: full scale sine at 2^26 bin power after window and scaling)
+    const float MaxLevelDown = 0.04;
+    for (int band = 0; band < numBands; band++) {
+        uint32_t power = 0;
+        for (int k = bandEdge[band]; k < bandEdge[band+1]; k++) {
+            int32_t r = re[revTable[k]];
+            int32_t m = im[revTable[k]];
+            uint32_t p = static_cast<uint32_t>(r * r) + static_cast<uint32_t>(m * m);
+            power = (power > UINT32_MAX - p) ? UINT32_MAX : power + p;
+        }
+        int32_t dBQ8 = (log2Q8(power) - 26 * 256) * 3;  // 10*log10(2) ~= 3
+        float level = static_cast<float>(dBQ8 + DbRange * 256) / (DbRange * 256);
+        if (level < 0.0) { level = 0.0; }
+        if (level > 1.0) { level = 1.0; }
+        // slow level down
+        bandLevel[band] = (bandLevel[band] - MaxLevelDown > level) ? bandLevel[band] - MaxLevelDown : level;
+        levels[band] = bandLevel[band];
+    }
+
+    costUs = time_us_32() - start;
+    if (costUs > maxCostUs) { maxCostUs = costUs; }
+    skipCount = costUs / BudgetUs;
+    return true;
+}
+
+uint32_t SpectrumAnalyzer::getCostUs()
+{
+    return costUs;
+}
+
+uint32_t SpectrumAnalyzer::getMaxCostUs()
+{
+    return maxCostUs;
+}
@@ -0,0 +1,80 @@
+/*------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/------------------------------------------------------*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "DspPipeline.h"
+
+//=================================
+// Interface of SpectrumAnalyzer Class
+//=================================
+// Decimated mono samples are published from the decode IRQ into a lock-free tap (single producer)
+// and transformed by fixed-point radix-4 FFT in the UI loop outside the IRQ
+class SpectrumAnalyzer
+{
+public:
+    static constexpr int FFT_SIZE = 256;  // must be power of 4
+    static constexpr int MAX_BANDS = 32;
+    static void initialize();
+    static void setEnabled(bool flag);
+    static bool isEnabled();
+    static void setSampFreq(uint32_t sampFreq);
+    static inline void feedFrame(int32_t sampleL, int32_t sampleR)  // called from decode IRQ
+    {
+        decimAccum += (sampleL >> 17) + (sampleR >> 17);  // mono in 16bit range
+        if (++decimCount >> decimShift) {
+            tap[tapWrIdx & (TAP_SIZE - 1)] = static_cast<int16_t>(decimAccum >> decimShift);
+            tapWrIdx = tapWrIdx + 1;
+            decimAccum = 0;
+            decimCount = 0;
+        }
+    }
+    static bool analyze(float* levels, int numBands);  // levels: 0.0 ~ 1.0
+    static uint32_t getCostUs();
+    static uint32_t getMaxCostUs();
+private:
+    static constexpr int TAP_SIZE = FFT_SIZE * 4;  // must be power of 2
+    static constexpr uint32_t BudgetUs = 2000;  // average cost cap per UI cycle
+    static constexpr int DbRange = 60;  // dB range mapped to level 0.0 ~ 1.0
+    static int16_t tap[TAP_SIZE];
+    static volatile uint32_t tapWrIdx;
+    static int32_t decimAccum;
+    static uint32_t decimCount;
+    static uint32_t decimShift;
+    static bool enabled;
+    static int16_t cosTable[FFT_SIZE];
+    static int16_t sinTable[FFT_SIZE];
+    static int16_t window[FFT_SIZE];
+    static uint8_t revTable[FFT_SIZE];
+    static uint16_t bandEdge[MAX_BANDS + 1];
+    static int numBandEdges;
+    static float bandLevel[MAX_BANDS];
+    static uint32_t costUs;
+    static uint32_t maxCostUs;
+    static uint32_t skipCount;
+    static void setupBands(int numBands);
+    static void fft(int32_t* re, int32_t* im);
+    static int32_t log2Q8(uint32_t value);
+};
+
+//=================================
+// Interface of SpectrumTapStage Class < DspStage
+//=================================
+class SpectrumTapStage : public DspStage
+{
+public:
+    static constexpr uint8_t Priority = 200;  // visual only, bypassed first
+    SpectrumTapStage() : DspStage("SpectrumTap", Priority) {}
+    void process(int32_t* frames, uint32_t numFrames)
+    {
+        for (uint32_t i = 0; i < numFrames; i++) {
+            SpectrumAnalyzer::feedFrame(frames[i*2+0], frames[i*2+1]);
+        }
+    }
+    bool isActive() const { return SpectrumAnalyzer::isEnabled(); }
+};
@@ -11,7 +11,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
+#include "hardware/sync.h"
+#include "pico/stdlib.h"
+
+#include "file_menu_coll.h"
+#include "io_service.h"
 #include "tf_card.h"
 
 //#define DEBUG_FILE_MENU
@@ -19,327 +25,1176 @@
 
 #define TGT_DIRS    (1<<0)
 #define TGT_FILES   (1<<1)
-#define FFL_SZ 8
+#define EXT_TYPE_MAX 8
+#define EXT_SZ 8
+
+// Sorted index of the directory consists of a record per entry (except "..") in sorted order.
+// It is sorted by external merge sort within IDX_RAM_BUDGET: sorted runs are spilled to IDX_TMP_FNAME
+// if the directory doesn't fit in one run, then merged into IDX_FNAME.
+// The records stay in RAM if they fit in IDX_RAM_BUDGET, otherwise they are paged from IDX_FNAME.
+// IDX_FNAME is also reused as cache while the signature of the directory matches.
+// Indexes held in RAM are kept for recently visited directories within IDX_LRU_BUDGET,
+// so that going back and forth the hierarchy doesn't build them again. They are trusted until unmount
+// because the player never modifies listed entries.
+#if PICO_RP2350
+#define IDX_RAM_BUDGET (64*1024)
+#define IDX_LRU_BUDGET (32*1024)
+#else
+#define IDX_RAM_BUDGET (16*1024)
+#define IDX_LRU_BUDGET (8*1024)
+#endif
+#define IDX_LRU_SLOTS 8
+#define IDX_FNAME ".file_menu.idx"
+#define IDX_TMP_FNAME ".file_menu.tmp"
+#define IDX_MAGIC 0x33494d46 // "FMI3"
+#define IDX_HASH_SEED 2166136261u
+#define IDX_CACHE_MIN_ENTRIES 32 // smaller directory is sorted quickly enough without cache file
+#define IDX_PAGE_SIZE 512
+#define IDX_HEADER_SIZE IDX_PAGE_SIZE
+#define IDX_NUM_PAGES 4
+#define IDX_PREFIX_STRIDE 256 // number of each type is kept every this number of records
+#define IDX_MAX_SKIP 16 // hidden entries allowed to be inserted before the entry after the scan
+#define IDX_STEP_ENTRIES 64 // entries read or merged by a step of the sort job
+#define IDX_PREVIEW_RECS 16 // first entries in sorted order available after the scan (a page of the list)
+
+#define REC_IS_FILE (1<<0)
+#define REC_TYPE_POS 1
+#define REC_TYPE_MASK (0x3<<REC_TYPE_POS)
+
+typedef struct {
+    DWORD dptr;  // position of DIR object to read the entry by f_readdir()
+    DWORD clust;
+    LBA_t sect;
+    uint32_t info; // REC_IS_FILE, file_menu_type_t << REC_TYPE_POS
+} idx_rec_t;
+
+#define IDX_PAGE_RECS (IDX_PAGE_SIZE / sizeof(idx_rec_t))
+
+typedef struct {
+    uint8_t key[COLL_KEY_SZ];
+    idx_rec_t rec;
+} idx_sort_rec_t;
+
+#define IDX_RUN_RECS (IDX_RAM_BUDGET / sizeof(idx_sort_rec_t))
+
+typedef struct {
+    uint32_t magic;
+    uint32_t rec_size;
+    uint32_t sclust; // start cluster of the directory
+    uint32_t num;    // number of records
+    uint32_t hash;   // of names, attributes, sizes and timestamps in directory order
+    uint32_t dir_num;
+    uint32_t type_num[FILE_MENU_NUM_TYPES];
+} idx_header_t;
+
+typedef struct {
+    uint32_t page;
+    uint32_t tick;
+    idx_rec_t recs[IDX_PAGE_RECS];
+} idx_page_t;
+
+typedef struct {
+    idx_header_t hdr;
+    idx_rec_t* rec_list; // all the records in RAM (NULL: paged from IDX_FNAME)
+    uint32_t* type_prefix[FILE_MENU_NUM_TYPES]; // number of the type before each IDX_PREFIX_STRIDE records
+    FIL fil; // IDX_FNAME
+    int fil_open;
+    idx_page_t page[IDX_NUM_PAGES];
+    uint32_t page_tick;
+    file_menu_stats_t stats;
+} idx_t;
+
+typedef struct {
+    idx_header_t hdr;
+    idx_rec_t* rec_list; // NULL: unused
+    uint32_t* type_prefix[FILE_MENU_NUM_TYPES];
+    uint32_t bytes;
+    uint32_t tick;
+} idx_lru_t;
+
+// The index is built by a job of small steps, each of which holds io_service lock without waiting for it.
+// A step reads, compares or writes at most about IDX_STEP_ENTRIES entries so that core1 gets back to
+// the audio streams and their bind requests in time.
+// core1 runs the steps while audio streams need no read (see file_menu_idle()), but leaves the steps
+// writing the card while a stream is filling, and core0 runs them by itself only when it needs the index before completion. The job builds into its own idx_t,
+// which core0 publishes for the UI at once when completed, so that the UI never sees partial index.
+// The directory is read only once unless the cached index turns out to be invalid: the scan collects
+// the entries into runs and keeps the first IDX_PREVIEW_RECS entries in sorted order as the preview,
+// which serves the first page of the list until the index is published.
+typedef enum {
+    JOB_NONE = 0,
+    JOB_PROBE,   // header of IDX_FNAME to tell if the scan needs to collect the entries
+    JOB_SCAN,    // signature of the directory, the preview and the runs
+    JOB_LOAD,    // cached index from IDX_FNAME
+    JOB_COLLECT, // read entries into the run buffer again
+    JOB_SORT,    // heap sort of the run buffer
+    JOB_SPILL,   // write the sorted run to IDX_TMP_FNAME
+    JOB_OUTPUT,  // output the records sorted in RAM
+    JOB_MERGE,   // merge spilled runs
+    JOB_DONE     // waiting to be published
+} idx_job_state_t;
+
+typedef enum {
+    IDX_NO_WAIT = 0,
+    IDX_WAIT_PREVIEW, // until the preview is available
+    IDX_WAIT_ALL      // until the index is published
+} idx_wait_t;
 
 static FATFS fs;
 static DIR dir;
-static FILINFO fno, fno_temp;
+static FILINFO fno;
 static int target = TGT_DIRS | TGT_FILES; // TGT_DIRS, TGT_FILES
-static int16_t f_stat_cnt;
-static uint16_t max_entry_cnt;
-static uint16_t* entry_list;
-static uint32_t* sorted_flg;
-static char (*fast_fname_list)[FFL_SZ];
-static uint32_t* is_file_flg; // 0: Dir, 1: File
-static uint16_t last_order; // order number memo for last file_menu_get_fname() request
+static uint32_t max_entry_cnt; // including ".." (0: not published)
+static idx_t idx_body[2];
+static idx_t* idx_cur = &idx_body[0]; // published for the UI
+static idx_lru_t idx_lru[IDX_LRU_SLOTS]; // recently visited directories (core0)
+static uint32_t idx_lru_tick;
+static uint32_t idx_lru_bytes;
+static uint32_t idx_lru_lookups;
+static uint32_t idx_lru_hits;
+static struct {
+    volatile idx_job_state_t state;
+    idx_t* idx; // being built
+    DIR dir;
+    FILINFO fno, fno_temp;
+    uint32_t t0;
+    int collect; // the scan reads entries into the run buffer
+    idx_sort_rec_t* buf; // run buffer
+    uint32_t buf_size; // grows up to IDX_RUN_RECS
+    uint32_t n; // records in buffer
+    uint32_t total; // records in spilled runs and buffer
+    uint32_t num_runs;
+    uint32_t* run_start;
+    uint32_t run_size;
+    int truncated;
+    idx_job_state_t resume; // after the run is spilled (JOB_MERGE: all the entries have been read)
+    uint32_t sort_i; // next node to sift in heapify
+    uint32_t sort_end; // heap size while extracting
+    uint32_t out_pos; // records in the run buffer spilled or output
+    // preview
+    volatile int preview; // available
+    idx_header_t preview_hdr;
+    idx_sort_rec_t top[IDX_PREVIEW_RECS];
+    uint32_t top_num;
+    // merge
+    uint32_t m; // buffer records per run
+    uint32_t filled; // runs whose buffer is filled
+    uint32_t* next; // next record to read from the file
+    uint32_t* pos; // head in buffer
+    uint32_t* len; // valid in buffer
+    uint32_t* heap;
+    uint32_t heap_num;
+} job;
+static FIL idx_tmp_fil; // IDX_TMP_FNAME (IDX_FNAME while probing)
+static uint32_t type_count[FILE_MENU_NUM_TYPES]; // work for type_prefix
+static uint32_t idx_out_cnt; // records output so far
+static int idx_out_fail; // a write into IDX_FNAME failed or was short
+static struct {
+    char ext[EXT_SZ];
+    file_menu_type_t type;
+} ext_type_list[EXT_TYPE_MAX];
+static int ext_type_num;
 
 //==============================
 // idx Internal Funcions
-//   provided by readdir 'index'
+//   provided by record number (= order - 1)
+//   FatFs is called directly while io_service lock is held by the caller unless noted
 //==============================
 
-static void idx_entry_swap(uint32_t entry_number1, uint32_t entry_number2)
+static uint32_t fnv1a(uint32_t hash, const void* data, size_t size)
 {
-    uint16_t tmp_entry;
-    tmp_entry = entry_list[entry_number1];
-    entry_list[entry_number1] = entry_list[entry_number2];
-    entry_list[entry_number2] = tmp_entry;
+    const uint8_t* ptr = (const uint8_t*) data;
+    while (size--) {
+        hash = (hash ^ *ptr++) * 16777619u;
+    }
+    return hash;
 }
 
-static int32_t my_strcmp(char* str1 , char* str2)
+// Signature of the entry (name, attribute, size and timestamp)
+static uint32_t idx_hash_entry(uint32_t hash, const FILINFO* fno)
 {
-    int32_t result = 0;
+    hash = fnv1a(hash, fno->fname, strlen(fno->fname));
+    hash = fnv1a(hash, &fno->fattrib, sizeof(fno->fattrib));
+    hash = fnv1a(hash, &fno->fsize, sizeof(fno->fsize));
+    hash = fnv1a(hash, &fno->fdate, sizeof(fno->fdate));
+    hash = fnv1a(hash, &fno->ftime, sizeof(fno->ftime));
+    return hash;
+}
 
-    // Compare until strings do not match
-    while (result == 0) {
-        result = *str1 - *str2;
-        if (*str1 == '\0' || *str2 == '\0') break;  //Comparing also ends when reading to the end of the string
-        str1++;
-        str2++;
+static int idx_is_target(const FILINFO* fno)
+{
+    if (fno->fname[0] == '.') return 0;
+    if (fno->fattrib & AM_HID) return 0;
+    if (!(target & TGT_DIRS)) { // File Only
+        if (fno->fattrib & AM_DIR) return 0;
+    } else if (!(target & TGT_FILES)) { // Dir Only
+        if (!(fno->fattrib & AM_DIR)) return 0;
     }
-    return result;
+    return 1;
 }
 
-static int32_t my_strncmp(char* str1 , char* str2, int size)
+static file_menu_type_t idx_classify(const FILINFO* fno)
 {
-    int32_t result = 0;
-    int32_t len = 0;
+    if (fno->fattrib & AM_DIR) return FILE_MENU_TYPE_OTHER;
+    const char* ext_pos = strrchr(fno->fname, '.');
+    if (ext_pos == NULL) return FILE_MENU_TYPE_OTHER;
+    for (int i = 0; i < ext_type_num; i++) {
+        if (strcasecmp(ext_pos+1, ext_type_list[i].ext) == 0) return ext_type_list[i].type;
+    }
+    return FILE_MENU_TYPE_OTHER;
+}
 
-    // Compare until strings do not match
-    while (result == 0) {
-        result = *str1 - *str2;
-        len++;
-        if (*str1 == '\0' || *str2 == '\0' || len >= size) break;   //Comparing also ends when reading to the end of the string
-        str1++;
-        str2++;
+static file_menu_type_t rec_get_type(const idx_rec_t* rec)
+{
+    return (file_menu_type_t) ((rec->info & REC_TYPE_MASK) >> REC_TYPE_POS);
+}
+
+// Equivalent to dir_sdi() of FatFs for the position recorded in the scan
+static FRESULT idx_read_entry(DIR* dp, const idx_rec_t* rec, FILINFO* fno)
+{
+    FRESULT fr;
+    dp->dptr = rec->dptr;
+    dp->clust = rec->clust;
+    dp->sect = rec->sect;
+    dp->dir = dp->obj.fs->win + rec->dptr % FF_MAX_SS;
+    for (int i = 0; i < IDX_MAX_SKIP; i++) {
+        fr = f_readdir(dp, fno);
+        if (fr != FR_OK) return fr;
+        if (fno->fname[0] == '\0') break;
+        if (idx_is_target(fno)) return FR_OK;
     }
-    return result;
+    printf("ERROR: idx_read_entry invalid position\n\r");
+    fno->fname[0] = '\0';
+    return FR_INT_ERR;
 }
 
-static FRESULT idx_f_stat(uint16_t idx, FILINFO* fno)
+static uint32_t idx_prefix_num(uint32_t num)
 {
-    FRESULT res = FR_OK;
-    int error_count = 0;
-    if (idx == 0) {
-        strncpy(fno->fname, "..", FF_LFN_BUF);
-        fno->fattrib = AM_DIR;
-        return res;
+    return num / IDX_PREFIX_STRIDE + 1;
+}
+
+static int idx_prefix_new(idx_t* idx, uint32_t num)
+{
+    for (int i = 0; i < FILE_MENU_NUM_TYPES; i++) {
+        idx->type_prefix[i] = (uint32_t*) malloc(sizeof(uint32_t) * idx_prefix_num(num));
+        if (idx->type_prefix[i] == NULL) {
+            printf("malloc type_prefix failed\n\r");
+            return 0;
+        }
     }
-    if (f_stat_cnt == 1 || f_stat_cnt > idx) {
-        // Rewind directory index
-        f_readdir(&dir, 0);
-        f_stat_cnt = 1;
+    idx->stats.ram_bytes += sizeof(uint32_t) * idx_prefix_num(num) * FILE_MENU_NUM_TYPES;
+    return 1;
+}
+
+static void idx_page_invalidate(idx_t* idx)
+{
+    for (int k = 0; k < IDX_NUM_PAGES; k++) {
+        idx->page[k].page = 0xffffffff;
+        idx->page[k].tick = 0;
     }
-    for (;;) {
-        f_readdir(&dir, fno);
-        if (fno->fname[0] == '\0') {
-            printf("Invalid empty name\n\r");
-            res = FR_INVALID_NAME;
-            if (error_count++ > 10) {
-                printf("ERROR: idx_f_stat invalid name\n\r");
-                break;
-            }
-            f_readdir(&dir, 0);
-            f_stat_cnt = 1;
-            continue;
+}
+
+static void idx_delete(idx_t* idx)
+{
+    free(idx->rec_list);
+    idx->rec_list = NULL;
+    for (int i = 0; i < FILE_MENU_NUM_TYPES; i++) {
+        free(idx->type_prefix[i]);
+        idx->type_prefix[i] = NULL;
+    }
+    if (idx->fil_open) {
+        f_close(&idx->fil);
+        idx->fil_open = 0;
+    }
+    idx_page_invalidate(idx);
+}
+
+// Record of published index (core0, takes io_service lock by itself to read a page)
+static const idx_rec_t* idx_get_rec(uint32_t i)
+{
+    idx_t* idx = idx_cur;
+    idx_page_t* page = &idx->page[0];
+    UINT br;
+    if (idx->rec_list != NULL) return &idx->rec_list[i];
+    for (int k = 0; k < IDX_NUM_PAGES; k++) {
+        if (idx->page[k].page == i / IDX_PAGE_RECS) {
+            page = &idx->page[k];
+            page->tick = ++idx->page_tick;
+            return &page->recs[i % IDX_PAGE_RECS];
         }
-        if (fno->fname[0] == '.') continue;
-        if (fno->fattrib & AM_HID) continue;
-        if (!(target & TGT_DIRS)) { // File Only
-            if (fno->fattrib & AM_DIR) continue;
-        } else if (!(target & TGT_FILES)) { // Dir Only
-            if (!(fno->fattrib & AM_DIR)) continue;
+        if (idx->page[k].tick < page->tick) page = &idx->page[k];
+    }
+    // replace least recently used page
+    page->page = i / IDX_PAGE_RECS;
+    page->tick = ++idx->page_tick;
+    if (io_f_lseek(IO_REQ_DIR, &idx->fil, IDX_HEADER_SIZE + (FSIZE_t) page->page * IDX_PAGE_SIZE) != FR_OK ||
+        io_f_read(IO_REQ_DIR, &idx->fil, page->recs, IDX_PAGE_SIZE, &br) != FR_OK) {
+        printf("ERROR: idx page read failed\n\r");
+        memset(page->recs, 0, IDX_PAGE_SIZE);
+        page->page = 0xffffffff;
+    }
+    return &page->recs[i % IDX_PAGE_RECS];
+}
+
+// Load index from IDX_FNAME if its signature matches current directory
+static int idx_load(idx_t* idx)
+{
+    idx_header_t header;
+    UINT br;
+    UINT size;
+    if (idx->hdr.num + 1 < IDX_CACHE_MIN_ENTRIES) return 0;
+    if (f_open(&idx->fil, IDX_FNAME, FA_READ) != FR_OK) return 0;
+    if (f_read(&idx->fil, &header, sizeof(header), &br) != FR_OK || br != sizeof(header) ||
+        memcmp(&header, &idx->hdr, sizeof(header)) != 0) {
+        f_close(&idx->fil);
+        return 0;
+    }
+    // prefix tables follow the records
+    if (!idx_prefix_new(idx, idx->hdr.num)) goto fail;
+    if (f_lseek(&idx->fil, IDX_HEADER_SIZE + (FSIZE_t) (idx->hdr.num + IDX_PAGE_RECS - 1) / IDX_PAGE_RECS * IDX_PAGE_SIZE) != FR_OK) goto fail;
+    size = sizeof(uint32_t) * idx_prefix_num(idx->hdr.num);
+    for (int i = 0; i < FILE_MENU_NUM_TYPES; i++) {
+        if (f_read(&idx->fil, idx->type_prefix[i], size, &br) != FR_OK || br != size) goto fail;
+    }
+    // records
+    if (idx->hdr.num * sizeof(idx_rec_t) <= IDX_RAM_BUDGET) {
+        size = idx->hdr.num * sizeof(idx_rec_t);
+        idx->rec_list = (idx_rec_t*) malloc(size);
+        if (idx->rec_list != NULL) {
+            if (f_lseek(&idx->fil, IDX_HEADER_SIZE) != FR_OK ||
+                f_read(&idx->fil, idx->rec_list, size, &br) != FR_OK || br != size) goto fail;
+            idx->stats.ram_bytes += size;
+            f_close(&idx->fil);
+            return 1;
         }
-        if (f_stat_cnt++ >= idx) break;
     }
-    return res;
+    idx->fil_open = 1;
+    idx->stats.paged = 1;
+    return 1;
+fail:
+    f_close(&idx->fil);
+    idx_delete(idx);
+    idx->stats.ram_bytes = 0;
+    return 0;
 }
 
-static void set_sorted(uint16_t pos) /* pos is entry_list's position, not index number */
+// Output of sorted records into rec_list and/or IDX_FNAME
+static int idx_out_begin(idx_t* idx, uint32_t num, int ram, int file)
 {
-    *(sorted_flg + (pos/32)) |= 1<<(pos%32);
+    idx_header_t header;
+    UINT bw;
+    idx_out_cnt = 0;
+    idx_out_fail = 0;
+    memset(type_count, 0, sizeof(type_count));
+    if (!idx_prefix_new(idx, num)) return 0;
+    if (ram && num > 0) {
+        idx->rec_list = (idx_rec_t*) malloc(sizeof(idx_rec_t) * num);
+        if (idx->rec_list == NULL) {
+            printf("malloc rec_list failed\n\r");
+            return 0;
+        }
+        idx->stats.ram_bytes += sizeof(idx_rec_t) * num;
+    }
+    if (file) {
+        if (f_open(&idx->fil, IDX_FNAME, FA_READ | FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) return ram;
+        f_chmod(IDX_FNAME, AM_HID, AM_HID);
+        // header is invalid until completed
+        memset(&header, 0, sizeof(header));
+        if (f_write(&idx->fil, &header, sizeof(header), &bw) != FR_OK || bw != sizeof(header) ||
+            f_lseek(&idx->fil, IDX_HEADER_SIZE) != FR_OK) {
+            f_close(&idx->fil);
+            f_unlink(IDX_FNAME);
+            return ram;
+        }
+        idx->fil_open = 1;
+        idx_page_invalidate(idx);
+    }
+    return 1;
 }
 
-static int get_sorted(uint16_t pos) /* pos is entry_list's position, not index number */
+static void idx_out_write(idx_t* idx, const void* buf, UINT size)
 {
-    return ((*(sorted_flg + (pos/32)) & 1<<(pos%32)) != 0);
+    UINT bw;
+    if (idx_out_fail) return;
+    if (f_write(&idx->fil, buf, size, &bw) != FR_OK || bw != size) idx_out_fail = 1;
 }
 
-static int get_range_full_sorted(uint16_t start, uint16_t end_1)
+static void idx_out_put(idx_t* idx, const idx_rec_t* rec)
 {
-    int res = 1;
-    for (int i = start; i < end_1; i++) {
-        res &= get_sorted(i);
+    idx_page_t* page = &idx->page[0]; // used as write buffer
+    if (idx_out_cnt % IDX_PREFIX_STRIDE == 0) {
+        for (int i = 0; i < FILE_MENU_NUM_TYPES; i++) {
+            idx->type_prefix[i][idx_out_cnt / IDX_PREFIX_STRIDE] = type_count[i];
+        }
+    }
+    type_count[rec_get_type(rec)]++;
+    if (idx->rec_list != NULL) idx->rec_list[idx_out_cnt] = *rec;
+    if (idx->fil_open) {
+        page->recs[idx_out_cnt % IDX_PAGE_RECS] = *rec;
+        if (idx_out_cnt % IDX_PAGE_RECS == IDX_PAGE_RECS - 1) {
+            idx_out_write(idx, page->recs, IDX_PAGE_SIZE);
+        }
     }
-    return res;
+    idx_out_cnt++;
 }
 
-static int get_range_full_unsorted(uint16_t start, uint16_t end_1)
+// returns 0 if IDX_FNAME failed to be written (then deleted)
+static int idx_out_end(idx_t* idx)
 {
-    int res = 0;
-    for (int i = start; i < end_1; i++) {
-        res |= get_sorted(i);
+    idx_page_t* page = &idx->page[0];
+    if (!idx->fil_open) return 1;
+    if (idx_out_cnt % IDX_PAGE_RECS != 0) {
+        memset(&page->recs[idx_out_cnt % IDX_PAGE_RECS], 0, sizeof(idx_rec_t) * (IDX_PAGE_RECS - idx_out_cnt % IDX_PAGE_RECS));
+        idx_out_write(idx, page->recs, IDX_PAGE_SIZE);
     }
-    return !res;
+    for (int i = 0; i < FILE_MENU_NUM_TYPES; i++) {
+        idx_out_write(idx, idx->type_prefix[i], sizeof(uint32_t) * idx_prefix_num(idx->hdr.num));
+    }
+    // header validates the file only if all the above has been written
+    if (!idx_out_fail && f_lseek(&idx->fil, 0) != FR_OK) idx_out_fail = 1;
+    idx_out_write(idx, &idx->hdr, sizeof(idx->hdr));
+    if (f_close(&idx->fil) != FR_OK) idx_out_fail = 1;
+    idx->fil_open = 0;
+    idx_page_invalidate(idx);
+    if (idx_out_fail) {
+        // don't leave broken file to be loaded as cache
+        printf("idx file write failed\n\r");
+        f_unlink(IDX_FNAME);
+        return 0;
+    }
+    if (idx->rec_list == NULL) {
+        // records are paged from the file
+        if (f_open(&idx->fil, IDX_FNAME, FA_READ) == FR_OK) {
+            idx->fil_open = 1;
+        } else {
+            printf("ERROR: idx file open failed\n\r");
+        }
+        idx->stats.paged = 1;
+    }
+    return 1;
 }
 
-static void set_is_file(uint16_t idx)
+static int idx_sort_cmp(const void* a, const void* b)
 {
-    *(is_file_flg + (idx/32)) |= 1<<(idx%32);
+    const idx_sort_rec_t* rec1 = (const idx_sort_rec_t*) a;
+    const idx_sort_rec_t* rec2 = (const idx_sort_rec_t*) b;
+    int result = (int) (rec1->rec.info & REC_IS_FILE) - (int) (rec2->rec.info & REC_IS_FILE); // directories first
+    if (result == 0) {
+        result = memcmp(rec1->key, rec2->key, COLL_KEY_SZ);
+    }
+    if (result == 0) {
+        // full name compare
+        idx_read_entry(&job.dir, &rec1->rec, &job.fno);
+        idx_read_entry(&job.dir, &rec2->rec, &job.fno_temp);
+        result = coll_strcmp(job.fno.fname, job.fno_temp.fname);
+        job.idx->stats.full_cmps++;
+    }
+    return result;
 }
 
-static int get_is_file(uint16_t idx)
+// Sift down the node of the heap, returns the number of compares
+static uint32_t idx_heap_sift(idx_sort_rec_t* buf, uint32_t i, uint32_t num)
 {
-    return ((*(is_file_flg + (idx/32)) & 1<<(idx%32)) != 0);
+    uint32_t cmps = 0;
+    for (;;) {
+        uint32_t c = i * 2 + 1;
+        if (c >= num) break;
+        if (c + 1 < num) {
+            cmps++;
+            if (idx_sort_cmp(&buf[c+1], &buf[c]) > 0) c++;
+        }
+        cmps++;
+        if (idx_sort_cmp(&buf[i], &buf[c]) >= 0) break;
+        idx_sort_rec_t tmp = buf[i]; buf[i] = buf[c]; buf[c] = tmp;
+        i = c;
+    }
+    return cmps;
 }
 
-static void idx_qsort_entry_list_by_range(uint16_t r_start, uint16_t r_end_1, uint16_t start, uint16_t end_1)
+//==============================
+// Recently Visited Directories
+//   keyed by start cluster of the directory (core0)
+//==============================
+
+static void idx_lru_free(idx_lru_t* ent)
 {
-    int result;
-    int start_next;
-    int end_1_next;
-    char* fno_ptr;
-    char* fno_temp_ptr;
-    if (r_start < start) r_start = start;
-    if (r_end_1 > end_1) r_end_1 = end_1;
-    if (get_range_full_sorted(r_start, r_end_1)) return;
-    if (get_range_full_sorted(start, end_1)) return;
-    if (!get_range_full_unsorted(start, end_1)) { // Sorting including previous sorted items broke correct result
-        start_next = start;
-        while (get_sorted(start_next)) {
-            start_next++;
+    free(ent->rec_list);
+    ent->rec_list = NULL;
+    for (int i = 0; i < FILE_MENU_NUM_TYPES; i++) {
+        free(ent->type_prefix[i]);
+        ent->type_prefix[i] = NULL;
+    }
+    idx_lru_bytes -= ent->bytes;
+    ent->bytes = 0;
+}
+
+static void idx_lru_clear(void)
+{
+    for (int i = 0; i < IDX_LRU_SLOTS; i++) {
+        idx_lru_free(&idx_lru[i]);
+    }
+}
+
+// Keep the index held in RAM of the directory being left (takes the records over from idx)
+static void idx_lru_put(idx_t* idx)
+{
+    uint32_t bytes;
+    idx_lru_t* ent;
+    if (idx->rec_list == NULL) return;
+    bytes = sizeof(idx_rec_t) * idx->hdr.num + sizeof(uint32_t) * idx_prefix_num(idx->hdr.num) * FILE_MENU_NUM_TYPES;
+    if (bytes > IDX_LRU_BUDGET) return;
+    for (int i = 0; i < IDX_LRU_SLOTS; i++) {
+        if (idx_lru[i].rec_list != NULL && idx_lru[i].hdr.sclust == idx->hdr.sclust) idx_lru_free(&idx_lru[i]);
+    }
+    // evict least recently used ones until both a slot and the budget are available
+    for (;;) {
+        idx_lru_t* lru = NULL;
+        ent = NULL;
+        for (int i = 0; i < IDX_LRU_SLOTS; i++) {
+            if (idx_lru[i].rec_list == NULL) {
+                ent = &idx_lru[i];
+            } else if (lru == NULL || idx_lru[i].tick < lru->tick) {
+                lru = &idx_lru[i];
+            }
         }
-        end_1_next = start_next+1;
-        while (!get_sorted(end_1_next) && end_1_next < end_1) {
-            end_1_next++;
+        if (ent != NULL && idx_lru_bytes + bytes <= IDX_LRU_BUDGET) break;
+        idx_lru_free(lru);
+    }
+    ent->hdr = idx->hdr;
+    ent->rec_list = idx->rec_list;
+    idx->rec_list = NULL;
+    for (int i = 0; i < FILE_MENU_NUM_TYPES; i++) {
+        ent->type_prefix[i] = idx->type_prefix[i];
+        idx->type_prefix[i] = NULL;
+    }
+    ent->bytes = bytes;
+    ent->tick = ++idx_lru_tick;
+    idx_lru_bytes += bytes;
+}
+
+// Take the index of the directory (idx->hdr.sclust) back if recently visited
+static int idx_lru_get(idx_t* idx)
+{
+    idx_lru_lookups++;
+    for (int i = 0; i < IDX_LRU_SLOTS; i++) {
+        idx_lru_t* ent = &idx_lru[i];
+        if (ent->rec_list == NULL || ent->hdr.sclust != idx->hdr.sclust) continue;
+        idx->hdr = ent->hdr;
+        idx->rec_list = ent->rec_list;
+        ent->rec_list = NULL;
+        for (int j = 0; j < FILE_MENU_NUM_TYPES; j++) {
+            idx->type_prefix[j] = ent->type_prefix[j];
+            ent->type_prefix[j] = NULL;
         }
+        idx->stats.num = idx->hdr.num + 1;
+        idx->stats.ram_bytes = ent->bytes;
+        idx->stats.peak_bytes = ent->bytes;
+        idx->stats.lru_hit = 1;
+        idx_lru_bytes -= ent->bytes;
+        ent->bytes = 0;
+        idx_lru_hits++;
         #ifdef DEBUG_FILE_MENU
-        printf("partial %d %d %d\n\r", start_next, end_1_next, end_1);
+        printf("file_menu: %lu entries, recently visited (hit %lu/%lu, %lu bytes kept)\n\r",
+            (unsigned long) idx->stats.num, (unsigned long) idx_lru_hits, (unsigned long) idx_lru_lookups, (unsigned long) idx_lru_bytes);
         #endif // #ifdef DEBUG_FILE_MENU
-        idx_qsort_entry_list_by_range(r_start, r_end_1, start_next, end_1_next);
-        if (end_1_next < end_1) {
-            idx_qsort_entry_list_by_range(r_start, r_end_1, end_1_next, end_1);
+        return 1;
+    }
+    return 0;
+}
+
+//==============================
+// Sort Job
+//   each step is called while io_service lock is held
+//==============================
+
+static void idx_job_free(void)
+{
+    free(job.buf);
+    free(job.run_start);
+    free(job.next);
+    free(job.pos);
+    free(job.len);
+    free(job.heap);
+    job.buf = NULL;
+    job.run_start = NULL;
+    job.next = NULL;
+    job.pos = NULL;
+    job.len = NULL;
+    job.heap = NULL;
+    job.buf_size = 0;
+    job.run_size = 0;
+}
+
+static void idx_job_done(void)
+{
+    idx_t* idx = job.idx;
+    idx_job_free();
+    idx->stats.num = idx->hdr.num + 1;
+    idx->stats.sort_ms = to_ms_since_boot(get_absolute_time()) - job.t0;
+    if (idx->stats.paged) idx->stats.ram_bytes += sizeof(idx->page);
+    if (idx->stats.peak_bytes < idx->stats.ram_bytes) idx->stats.peak_bytes = idx->stats.ram_bytes;
+    #ifdef DEBUG_FILE_MENU
+    printf("file_menu: %lu entries, %s, %lu ms (first page %lu ms), RAM %lu bytes (peak %lu)\n\r",
+        (unsigned long) idx->stats.num,
+        idx->stats.cache_hit ? "cached" : (idx->stats.runs > 0) ? "merged runs" : "sorted",
+        (unsigned long) idx->stats.sort_ms, (unsigned long) idx->stats.preview_ms,
+        (unsigned long) idx->stats.ram_bytes, (unsigned long) idx->stats.peak_bytes);
+    #endif // #ifdef DEBUG_FILE_MENU
+    __dmb(); // publish the index before the state
+    job.state = JOB_DONE;
+}
+
+static void idx_job_tmp_delete(void)
+{
+    if (job.num_runs == 0) return;
+    f_close(&idx_tmp_fil);
+    f_unlink(IDX_TMP_FNAME);
+    job.num_runs = 0;
+}
+
+// Sort the run buffer by following steps, then go on to 'resume'
+static void idx_job_sort_begin(idx_job_state_t resume)
+{
+    job.resume = resume;
+    job.sort_i = job.n / 2;
+    job.sort_end = job.n;
+    job.state = JOB_SORT;
+}
+
+// Heap sort of the run buffer a part at a time (a full name compare reads two entries)
+// returns 1 if completed
+static int idx_job_sort(void)
+{
+    DIR dir_save = job.dir; // full name compare moves the directory position
+    uint32_t cmps = 0;
+    while (cmps < IDX_STEP_ENTRIES) {
+        if (job.sort_i > 0) {
+            cmps += idx_heap_sift(job.buf, --job.sort_i, job.sort_end); // heapify
+        } else if (job.sort_end > 1) {
+            // move the largest to the end
+            idx_sort_rec_t tmp = job.buf[0]; job.buf[0] = job.buf[job.sort_end-1]; job.buf[job.sort_end-1] = tmp;
+            cmps += idx_heap_sift(job.buf, 0, --job.sort_end);
+        } else {
+            break;
         }
-        return;
     }
-    #ifdef DEBUG_FILE_MENU_LVL2
-    printf("r_start %d r_end_1 %d start %d end_1 %d\n\r", r_start, r_end_1, start, end_1);
-    printf("\n\r");
-    for (int k = start; k < end_1; k++) {
-        idx_f_stat(entry_list[k], &fno);
-        printf("before[%d] %d %s\n\r", k, entry_list[k], fno.fname);
-    }
-    #endif // #ifdef DEBUG_FILE_MENU_LVL2
-    if (end_1 - start <= 1) {
-        set_sorted(start);
-    } else if (end_1 - start <= 2) {
-        // try fast_fname_list compare
-        result = get_is_file(entry_list[start]) - get_is_file(entry_list[start+1]);
-        if (result == 0) {
-            result = my_strncmp(fast_fname_list[entry_list[start]], fast_fname_list[entry_list[start+1]], FFL_SZ);
+    job.dir = dir_save;
+    return (job.sort_i == 0 && job.sort_end <= 1);
+}
+
+static void idx_job_sort_end(void)
+{
+    job.out_pos = 0;
+    if (job.resume == JOB_MERGE && (job.num_runs == 0 || job.truncated)) {
+        job.state = JOB_OUTPUT; // sorted in RAM
+    } else {
+        job.state = JOB_SPILL;
+    }
+}
+
+// Spill the sorted run to IDX_TMP_FNAME a part at a time
+// returns -1: not writable, 0: continued, 1: completed
+static int idx_job_spill(void)
+{
+    UINT bw;
+    uint32_t num = job.n - job.out_pos;
+    if (job.n == 0) return 1; // no last run
+    if (job.out_pos == 0) {
+        if (job.num_runs + 3 > job.run_size) { // start of each run, the last run and the end
+            uint32_t* run_start = (uint32_t*) realloc(job.run_start, sizeof(uint32_t) * (job.run_size + 8));
+            if (run_start == NULL) return -1;
+            job.run_start = run_start;
+            job.run_size += 8;
         }
-        //printf("fast_fname_list %s %s %d, %d\n\r", fast_fname_list[entry_list[0]], fast_fname_list[entry_list[1]], entry_list[0], entry_list[1]);
-        if (result > 0) {
-            idx_entry_swap(start, start+1);
-        } else if (result < 0) {
-            // do nothing
-        } else {
-            // full name compare
-            idx_f_stat(entry_list[start], &fno);
-            idx_f_stat(entry_list[start+1], &fno_temp);
-            fno_ptr = (strncmp(fno.fname, "The ", 4) == 0) ? &fno.fname[4] : fno.fname;
-            fno_temp_ptr = (strncmp(fno_temp.fname, "The ", 4) == 0) ? &fno_temp.fname[4] : fno_temp.fname;
-            result = my_strcmp(fno_ptr, fno_temp_ptr);
-            if (result >= 0) {
-                idx_entry_swap(start, start+1);
-            }
+        if (job.num_runs == 0) {
+            if (f_open(&idx_tmp_fil, IDX_TMP_FNAME, FA_READ | FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) return -1;
+            f_chmod(IDX_TMP_FNAME, AM_HID, AM_HID); // visible only if power is lost in the middle of sort
+        }
+        job.run_start[job.num_runs++] = job.total - job.n;
+    }
+    if (num > IDX_STEP_ENTRIES) num = IDX_STEP_ENTRIES;
+    if (f_write(&idx_tmp_fil, &job.buf[job.out_pos], sizeof(idx_sort_rec_t) * num, &bw) != FR_OK || bw != sizeof(idx_sort_rec_t) * num) {
+        printf("ERROR: idx run write failed\n\r");
+    }
+    job.out_pos += num;
+    return (job.out_pos >= job.n) ? 1 : 0;
+}
+
+// Add the entry into the run buffer, which grows up to IDX_RUN_RECS
+// returns 1 if the buffer is full, then the run is sorted and spilled by following steps
+static int idx_job_add(const idx_sort_rec_t* item)
+{
+    if (job.truncated) return 0;
+    if (job.n == job.buf_size) {
+        uint32_t size = (job.buf_size == 0) ? IDX_STEP_ENTRIES : job.buf_size * 2;
+        if (size > IDX_RUN_RECS) size = IDX_RUN_RECS;
+        idx_sort_rec_t* buf = (idx_sort_rec_t*) realloc(job.buf, sizeof(idx_sort_rec_t) * size);
+        if (buf == NULL) {
+            printf("WARNING: %lu entries are listed (malloc idx sort buffer failed)\n\r", (unsigned long) job.n);
+            job.truncated = 1;
+            return 0;
         }
-        set_sorted(start);
-        set_sorted(start+1);
+        job.buf = buf;
+        job.buf_size = size;
+    }
+    job.buf[job.n++] = *item;
+    job.total++;
+    if (job.n < IDX_RUN_RECS) return 0;
+    idx_job_sort_begin(job.state); // the scan or the collection resumes after the spill
+    return 1;
+}
+
+// Compare the entry just read into job.fno with the record in preview
+static int idx_job_top_cmp(const idx_sort_rec_t* item, const idx_sort_rec_t* top)
+{
+    int result = (int) (item->rec.info & REC_IS_FILE) - (int) (top->rec.info & REC_IS_FILE); // directories first
+    if (result == 0) {
+        result = memcmp(item->key, top->key, COLL_KEY_SZ);
+    }
+    if (result == 0) {
+        // full name compare without losing the scan position
+        DIR dir_save = job.dir;
+        idx_read_entry(&job.dir, &top->rec, &job.fno_temp);
+        job.dir = dir_save;
+        result = coll_strcmp(job.fno.fname, job.fno_temp.fname);
+        job.idx->stats.full_cmps++;
+    }
+    return result;
+}
+
+// Keep the smallest IDX_PREVIEW_RECS entries in sorted order
+static void idx_job_top(const idx_sort_rec_t* item)
+{
+    uint32_t i = job.top_num;
+    if (i == IDX_PREVIEW_RECS) {
+        if (idx_job_top_cmp(item, &job.top[i-1]) >= 0) return;
+        i--; // the last one is dropped
     } else {
-        int top = start;
-        int bottom = end_1 - 1;
-        uint16_t key_idx = entry_list[start+(end_1-start)/2];
-        idx_f_stat(key_idx, &fno_temp);
-        #ifdef DEBUG_FILE_MENU_LVL2
-        printf("key %s\n\r", fno_temp.fname);
-        #endif // #ifdef DEBUG_FILE_MENU_LVL2
-        while (1) {
-            // try fast_fname_list compare
-            result = get_is_file(entry_list[top]) - get_is_file(key_idx);
-            if (result == 0) {
-                result = my_strncmp(fast_fname_list[entry_list[top]], fast_fname_list[key_idx], FFL_SZ);
-            }
-            if (result < 0) {
-                top++;
-            } else if (result > 0) {
-                idx_entry_swap(top, bottom);
-                bottom--;               
-            } else {
-                // full name compare
-                idx_f_stat(entry_list[top], &fno);
-                fno_ptr = (strncmp(fno.fname, "The ", 4) == 0) ? &fno.fname[4] : fno.fname;
-                fno_temp_ptr = (strncmp(fno_temp.fname, "The ", 4) == 0) ? &fno_temp.fname[4] : fno_temp.fname;
-                result = my_strcmp(fno_ptr, fno_temp_ptr);
-                if (result < 0) {
-                    top++;
-                } else {
-                    idx_entry_swap(top, bottom);
-                    bottom--;
-                }
-            }
-            if (top > bottom) break;
+        job.top_num++;
+    }
+    while (i > 0 && idx_job_top_cmp(item, &job.top[i-1]) < 0) {
+        job.top[i] = job.top[i-1];
+        i--;
+    }
+    job.top[i] = *item;
+}
+
+// The scan collects the entries into runs unless the cached index of the directory is likely to be valid
+static void idx_job_probe(void)
+{
+    idx_header_t header;
+    UINT br;
+    job.collect = 1;
+    if (f_open(&idx_tmp_fil, IDX_FNAME, FA_READ) == FR_OK) {
+        if (f_read(&idx_tmp_fil, &header, sizeof(header), &br) == FR_OK && br == sizeof(header) &&
+            header.magic == IDX_MAGIC && header.rec_size == sizeof(idx_rec_t) && header.sclust == job.idx->hdr.sclust) {
+            job.collect = 0;
         }
-        #ifdef DEBUG_FILE_MENU_LVL2
-        for (int k = 0; k < top; k++) {
-            idx_f_stat(entry_list[k], &fno);
-            printf("top[%d] %d %s\n\r", k, entry_list[k], fno.fname);
+        f_close(&idx_tmp_fil);
+    }
+}
+
+// Scan a part of the directory for its signature (number of entries, hash, number of each type) and the preview
+// returns 1 if completed
+static int idx_job_scan(void)
+{
+    idx_header_t* hdr = &job.idx->hdr;
+    idx_sort_rec_t item;
+    file_menu_type_t type;
+    for (int i = 0; i < IDX_STEP_ENTRIES; i++) {
+        // position to read the entry again
+        item.rec.dptr = job.dir.dptr;
+        item.rec.clust = job.dir.clust;
+        item.rec.sect = job.dir.sect;
+        if (f_readdir(&job.dir, &job.fno) != FR_OK || job.fno.fname[0] == '\0') return 1;
+        if (!idx_is_target(&job.fno)) continue;
+        hdr->hash = idx_hash_entry(hdr->hash, &job.fno);
+        if (job.fno.fattrib & AM_DIR) hdr->dir_num++;
+        type = idx_classify(&job.fno);
+        hdr->type_num[type]++;
+        hdr->num++;
+        coll_key(job.fno.fname, item.key);
+        item.rec.info = ((job.fno.fattrib & AM_DIR) ? 0 : REC_IS_FILE) | (type << REC_TYPE_POS);
+        if (!job.truncated) idx_job_top(&item);
+        if (job.collect && idx_job_add(&item)) return 0;
+    }
+    return 0;
+}
+
+// Collect the entries again because the cached index turned out to be invalid
+static void idx_job_collect_begin(void)
+{
+    job.n = 0;
+    job.total = 0;
+    job.truncated = 0;
+    // Rewind directory index
+    f_readdir(&job.dir, 0);
+    job.state = JOB_COLLECT;
+}
+
+// Read the next records of the run into its buffer
+static int idx_job_merge_read(uint32_t r)
+{
+    UINT br;
+    uint32_t n = job.run_start[r+1] - job.next[r];
+    if (n > job.m) n = job.m;
+    if (f_lseek(&idx_tmp_fil, (FSIZE_t) job.next[r] * sizeof(idx_sort_rec_t)) != FR_OK ||
+        f_read(&idx_tmp_fil, &job.buf[r * job.m], n * sizeof(idx_sort_rec_t), &br) != FR_OK || br != n * sizeof(idx_sort_rec_t)) {
+        return 0;
+    }
+    job.next[r] += n;
+    job.pos[r] = 0;
+    job.len[r] = n;
+    return 1;
+}
+
+// IDX_FNAME is not writable (card full), then merge the runs again into RAM beyond IDX_RAM_BUDGET
+static int idx_job_merge_restart(void)
+{
+    idx_t* idx = job.idx;
+    idx_out_end(idx);
+    idx_delete(idx);
+    idx->stats.ram_bytes = 0;
+    idx->stats.paged = 0;
+    if (!idx_out_begin(idx, job.total, 1, 0)) return 0;
+    printf("WARNING: idx of %lu entries is kept in RAM\n\r", (unsigned long) job.total);
+    for (uint32_t r = 0; r < job.num_runs; r++) {
+        job.next[r] = job.run_start[r];
+    }
+    job.heap_num = 0;
+    job.filled = 0;
+    return 1;
+}
+
+static void idx_job_merge_end(int ok)
+{
+    idx_t* idx = job.idx;
+    if (!ok) {
+        printf("ERROR: idx merge failed\n\r");
+        idx->hdr.num = idx_out_cnt;
+    }
+    if (!idx_out_end(idx) && ok && idx->rec_list == NULL && idx_job_merge_restart()) return;
+    if (idx->rec_list == NULL && !idx->fil_open) idx->hdr.num = 0; // records are lost
+    idx_job_tmp_delete();
+    idx_job_done();
+}
+
+// All the runs have been spilled
+static void idx_job_merge_begin(void)
+{
+    idx_t* idx = job.idx;
+    uint32_t k = job.num_runs;
+    job.run_start[k] = job.total;
+    idx->hdr.num = job.total;
+    idx->stats.runs = k;
+    idx->stats.peak_bytes = sizeof(idx_sort_rec_t) * job.buf_size + sizeof(uint32_t) * job.run_size;
+    if (!idx_out_begin(idx, job.total, job.total * sizeof(idx_rec_t) <= IDX_RAM_BUDGET, 1) || (idx->rec_list == NULL && !idx->fil_open)) {
+        // IDX_FNAME is not writable, then in RAM beyond IDX_RAM_BUDGET
+        idx_delete(idx);
+        idx->stats.ram_bytes = 0;
+        if (!idx_out_begin(idx, job.total, 1, 0)) {
+            printf("ERROR: idx output failed\n\r");
+            idx->hdr.num = 0;
+            idx_job_tmp_delete();
+            idx_job_done();
+            return;
         }
-        for (int k = top; k < max_entry_cnt; k++) {
-            idx_f_stat(entry_list[k], &fno);
-            printf("bottom[%d] %d %s\n\r", k, entry_list[k], fno.fname);
+    }
+    idx->stats.peak_bytes += idx->stats.ram_bytes;
+    job.m = job.buf_size / k;
+    if (job.m > IDX_STEP_ENTRIES) job.m = IDX_STEP_ENTRIES; // read of a step
+    job.next = (uint32_t*) malloc(sizeof(uint32_t) * k);
+    job.pos = (uint32_t*) malloc(sizeof(uint32_t) * k);
+    job.len = (uint32_t*) malloc(sizeof(uint32_t) * k);
+    job.heap = (uint32_t*) malloc(sizeof(uint32_t) * k);
+    job.heap_num = 0;
+    job.filled = 0;
+    if (job.next == NULL || job.pos == NULL || job.len == NULL || job.heap == NULL || job.m == 0) {
+        idx_job_merge_end(0);
+        return;
+    }
+    idx->stats.peak_bytes += sizeof(uint32_t) * k * 4;
+    for (uint32_t r = 0; r < k; r++) {
+        job.next[r] = job.run_start[r];
+    }
+    job.state = JOB_MERGE;
+}
+
+// k-way merge of sorted runs in IDX_TMP_FNAME, returns -1: error, 0: continued, 1: completed
+static int idx_job_merge(void)
+{
+    idx_t* idx = job.idx;
+    #define RUN_HEAD(r) (&job.buf[(r) * job.m + job.pos[r]])
+    if (job.filled < job.num_runs) {
+        // fill the buffer of a run and build heap
+        uint32_t r = job.filled++;
+        if (!idx_job_merge_read(r)) return -1;
+        // sift up
+        uint32_t i = job.heap_num++;
+        job.heap[i] = r;
+        while (i > 0 && idx_sort_cmp(RUN_HEAD(job.heap[(i-1)/2]), RUN_HEAD(job.heap[i])) > 0) {
+            uint32_t tmp = job.heap[i]; job.heap[i] = job.heap[(i-1)/2]; job.heap[(i-1)/2] = tmp;
+            i = (i-1)/2;
         }
-        #endif // #ifdef DEBUG_FILE_MENU_LVL2
-        if ((r_start < top && r_end_1 > start) && !get_range_full_sorted(start, top)) {
-            if (top - start > 1) {
-                idx_qsort_entry_list_by_range(r_start, r_end_1, start, top);
+        return 0;
+    }
+    for (int cnt = 0; cnt < IDX_STEP_ENTRIES; cnt++) {
+        if (job.heap_num == 0) return 1;
+        uint32_t r = job.heap[0];
+        int refilled = 0;
+        idx_out_put(idx, &RUN_HEAD(r)->rec);
+        if (idx_out_fail && idx->rec_list == NULL) return idx_job_merge_restart() ? 0 : -1;
+        if (++job.pos[r] >= job.len[r]) {
+            if (job.next[r] < job.run_start[r+1]) {
+                if (!idx_job_merge_read(r)) return -1;
+                refilled = 1;
             } else {
-                set_sorted(start);
+                job.heap[0] = job.heap[--job.heap_num]; // run exhausted
             }
         }
-        if ((r_start < end_1 && r_end_1 > top) && !get_range_full_sorted(top, end_1)) {
-            if (end_1 - top > 1) {
-                idx_qsort_entry_list_by_range(r_start, r_end_1, top, end_1);
-            } else {
-                set_sorted(top);
-            }
+        // sift down
+        uint32_t i = 0;
+        for (;;) {
+            uint32_t c = i * 2 + 1;
+            if (c >= job.heap_num) break;
+            if (c + 1 < job.heap_num && idx_sort_cmp(RUN_HEAD(job.heap[c+1]), RUN_HEAD(job.heap[c])) < 0) c++;
+            if (idx_sort_cmp(RUN_HEAD(job.heap[i]), RUN_HEAD(job.heap[c])) <= 0) break;
+            uint32_t tmp = job.heap[i]; job.heap[i] = job.heap[c]; job.heap[c] = tmp;
+            i = c;
         }
+        if (refilled) break; // a read is enough for a step
     }
+    #undef RUN_HEAD
+    return (job.heap_num == 0) ? 1 : 0;
 }
 
-static uint16_t idx_get_size(int target)
+static void idx_job_spill_end(int ok)
 {
-    int16_t cnt = 1;
-    // Rewind directory index
-    f_readdir(&dir, 0);
-    // Directory search completed with null character
-    for (;;) {
-        f_readdir(&dir, &fno);
-        if (fno.fname[0] == '\0') break;
-        if (fno.fname[0] == '.') continue;
-        if (fno.fattrib & AM_HID) continue;
-        if (!(target & TGT_DIRS)) { // File Only
-            if (fno.fattrib & AM_DIR) continue;
-        } else if (!(target & TGT_FILES)) { // Dir Only
-            if (!(fno.fattrib & AM_DIR)) continue;
+    if (!ok) {
+        printf("WARNING: %lu entries are listed (%s is not writable)\n\r", (unsigned long) job.n, IDX_TMP_FNAME);
+        job.truncated = 1;
+        job.out_pos = 0;
+        job.state = (job.resume == JOB_MERGE) ? JOB_OUTPUT : job.resume;
+    } else if (job.resume == JOB_MERGE) {
+        idx_job_merge_begin();
+    } else {
+        job.n = 0;
+        job.state = job.resume;
+    }
+}
+
+// Output the records sorted in RAM a part at a time, returns 1 if completed
+static int idx_job_output(void)
+{
+    idx_t* idx = job.idx;
+    if (job.out_pos == 0) {
+        idx_job_tmp_delete();
+        idx->hdr.num = job.n;
+        idx->stats.peak_bytes = sizeof(idx_sort_rec_t) * job.buf_size + sizeof(uint32_t) * job.run_size;
+        if (!idx_out_begin(idx, job.n, 1, !job.truncated && job.n + 1 >= IDX_CACHE_MIN_ENTRIES)) {
+            idx->hdr.num = 0;
+            return 1;
         }
-        cnt++;
-    }
-    // Returns the number of entries read
-    return cnt;
-}
-
-static void idx_sort_new(void)
-{
-    int i, k;
-    max_entry_cnt = idx_get_size(target);
-    entry_list = (uint16_t*) malloc(sizeof(uint16_t) * max_entry_cnt);
-    if (entry_list == NULL) printf("malloc entry_list failed\n\r");
-    for (i = 0; i < max_entry_cnt; i++) entry_list[i] = i;
-    sorted_flg = (uint32_t*) malloc(sizeof(uint32_t) * (max_entry_cnt+31)/32);
-    if (sorted_flg == NULL) printf("malloc sorted_flg failed\n\r");
-    memset(sorted_flg, 0, sizeof(uint32_t) * (max_entry_cnt+31)/32);
-    is_file_flg = (uint32_t*) malloc(sizeof(uint32_t) * (max_entry_cnt+31)/32);
-    if (is_file_flg == NULL) printf("malloc is_file_flg failed\n\r");
-    memset(is_file_flg, 0, sizeof(uint32_t) * (max_entry_cnt+31)/32);
-    fast_fname_list = (char (*)[FFL_SZ]) malloc(sizeof(char[FFL_SZ]) * max_entry_cnt);
-    if (fast_fname_list == NULL) printf("malloc fast_fname_list failed\n\r");
-    for (i = 0; i < max_entry_cnt; i++) {
-        idx_f_stat(i, &fno);
-        if (!(fno.fattrib & AM_DIR)) set_is_file(i);
-        if (strncmp(fno.fname, "The ", 4) == 0) {
-            for (k = 0; k < FFL_SZ; k++) {
-                fast_fname_list[i][k] = fno.fname[k+4];
+    }
+    for (int cnt = 0; cnt < IDX_STEP_ENTRIES && job.out_pos < job.n; cnt++) {
+        idx_out_put(idx, &job.buf[job.out_pos++].rec);
+    }
+    if (job.out_pos < job.n) return 0;
+    idx_out_end(idx);
+    return 1;
+}
+
+// All the entries have been read, then the last run is sorted
+static void idx_job_collect_end(void)
+{
+    idx_job_sort_begin(JOB_MERGE);
+}
+
+// Read entries into runs again
+static void idx_job_collect(void)
+{
+    uint32_t num = job.idx->hdr.num;
+    idx_sort_rec_t item;
+    for (int cnt = 0; cnt < IDX_STEP_ENTRIES; cnt++) {
+        // position to read the entry again
+        item.rec.dptr = job.dir.dptr;
+        item.rec.clust = job.dir.clust;
+        item.rec.sect = job.dir.sect;
+        if (job.total >= num || job.truncated || f_readdir(&job.dir, &job.fno) != FR_OK || job.fno.fname[0] == '\0') {
+            idx_job_collect_end();
+            return;
+        }
+        if (!idx_is_target(&job.fno)) continue;
+        coll_key(job.fno.fname, item.key);
+        item.rec.info = ((job.fno.fattrib & AM_DIR) ? 0 : REC_IS_FILE) | (idx_classify(&job.fno) << REC_TYPE_POS);
+        if (idx_job_add(&item)) return;
+    }
+}
+
+// Steps writing the card
+static int idx_job_writes(idx_job_state_t state)
+{
+    return state == JOB_SPILL || state == JOB_OUTPUT || state == JOB_MERGE;
+}
+
+// Run a step of the job (either core), never waits for the lock
+// may_write: false to leave the steps writing the card (core1 while an audio stream is filling)
+// returns true if the step was done
+static bool idx_job_step(bool may_write)
+{
+    idx_job_state_t state = job.state;
+    int result;
+    if (state == JOB_NONE || state == JOB_DONE) return false;
+    if (!may_write && idx_job_writes(state)) return false;
+    if (!io_try_lock(IO_REQ_DIR)) return false;
+    state = job.state; // could be cancelled or advanced by the other core meanwhile
+    if (!may_write && idx_job_writes(state)) state = JOB_NONE; // left to the next call
+    switch (state) {
+        case JOB_PROBE:
+            idx_job_probe();
+            job.state = JOB_SCAN;
+            break;
+        case JOB_SCAN:
+            if (idx_job_scan()) {
+                job.preview_hdr = job.idx->hdr;
+                job.idx->stats.preview_ms = to_ms_since_boot(get_absolute_time()) - job.t0;
+                __dmb(); // publish the preview before the flag
+                job.preview = 1;
+                if (job.collect) {
+                    idx_job_collect_end();
+                } else {
+                    job.state = JOB_LOAD;
+                }
             }
-        } else {
-            for (k = 0; k < FFL_SZ; k++) {
-                fast_fname_list[i][k] = fno.fname[k];
+            break;
+        case JOB_LOAD:
+            if (idx_load(job.idx)) {
+                job.idx->stats.cache_hit = 1;
+                idx_job_done();
+            } else {
+                idx_job_collect_begin();
             }
-        }
-        #ifdef DEBUG_FILE_MENU_LVL2
-        char temp_str[5] = "    ";
-        strncpy(temp_str, fast_fname_list[i], 4);
-        printf("fast_fname_list[%d] = %4s, is_file = %d\r\n", i, temp_str, get_is_file(i));
-        #endif // #ifdef DEBUG_FILE_MENU_LVL2
+            break;
+        case JOB_COLLECT:
+            idx_job_collect();
+            break;
+        case JOB_SORT:
+            if (idx_job_sort()) idx_job_sort_end();
+            break;
+        case JOB_SPILL:
+            result = idx_job_spill();
+            if (result != 0) idx_job_spill_end(result > 0);
+            break;
+        case JOB_OUTPUT:
+            if (idx_job_output()) {
+                job.idx->stats.peak_bytes += job.idx->stats.ram_bytes;
+                idx_job_done();
+            }
+            break;
+        case JOB_MERGE:
+            result = idx_job_merge();
+            if (result != 0) idx_job_merge_end(result > 0);
+            break;
+        default:
+            break;
+    }
+    io_unlock(IO_REQ_DIR);
+    return true;
+}
+
+// Start the job for the directory opened in dir (core0)
+static void idx_job_start(void)
+{
+    idx_t* idx = (idx_cur == &idx_body[0]) ? &idx_body[1] : &idx_body[0];
+    idx_header_t* hdr = &idx->hdr;
+    int hit;
+    memset(&idx->stats, 0, sizeof(idx->stats));
+    idx_page_invalidate(idx);
+    memset(hdr, 0, sizeof(idx_header_t));
+    hdr->magic = IDX_MAGIC;
+    hdr->rec_size = sizeof(idx_rec_t);
+    hdr->sclust = dir.obj.sclust;
+    hdr->hash = IDX_HASH_SEED;
+    hdr->type_num[FILE_MENU_TYPE_OTHER] = 1; // ".."
+    hdr->dir_num = 0;
+    hit = idx_lru_get(idx);
+    io_lock(IO_REQ_DIR);
+    job.idx = idx;
+    job.dir = dir;
+    job.t0 = to_ms_since_boot(get_absolute_time());
+    job.n = 0;
+    job.total = 0;
+    job.num_runs = 0;
+    job.truncated = 0;
+    job.top_num = 0;
+    job.preview = 0;
+    // Rewind directory index
+    f_readdir(&job.dir, 0);
+    job.state = hit ? JOB_DONE : JOB_PROBE; // recently visited one is published at once
+    io_unlock(IO_REQ_DIR); // wakes core1 as well
+}
+
+// Cancel the job and discard what it built (core0)
+static void idx_job_cancel(void)
+{
+    if (job.state == JOB_NONE) return;
+    io_lock(IO_REQ_DIR); // the step in progress completes
+    if (job.state == JOB_DONE) idx_lru_put(job.idx); // completed, but not published yet
+    idx_job_tmp_delete();
+    idx_job_free();
+    idx_delete(job.idx); // header of unfinished IDX_FNAME is left invalid
+    job.preview = 0;
+    job.state = JOB_NONE;
+    io_unlock(IO_REQ_DIR);
+}
+
+// Publish the index completed by the job (core0), waiting for the preview or the completion
+// returns 1 if published (or no job), otherwise 0 (then the preview is available if waited for)
+static int idx_sync(idx_wait_t wait)
+{
+    idx_job_state_t state;
+    while ((state = job.state) != JOB_NONE && state != JOB_DONE) {
+        if (wait == IDX_NO_WAIT || (wait == IDX_WAIT_PREVIEW && job.preview)) return 0;
+        // run by itself unless core1 is in the step
+        if (!idx_job_step(true)) __wfe(); // woken by io_unlock()
+    }
+    if (state == JOB_DONE) {
+        __dmb();
+        idx_cur = job.idx;
+        max_entry_cnt = idx_cur->hdr.num + 1;
+        job.preview = 0;
+        job.state = JOB_NONE;
+    }
+    return 1;
+}
+
+// Record of the order (core0), served by the preview without waiting for the index if possible
+static const idx_rec_t* idx_get_order_rec(uint32_t order)
+{
+    if (!idx_sync(IDX_WAIT_PREVIEW)) {
+        if (order <= job.top_num) return &job.top[order - 1].rec;
+        if (order > job.preview_hdr.num) return NULL;
+        idx_sync(IDX_WAIT_ALL);
     }
+    return (order < max_entry_cnt) ? idx_get_rec(order - 1) : NULL;
 }
 
+// Header of the directory (core0), the preview is used until the index is published
+static const idx_header_t* idx_get_hdr(void)
+{
+    if (!idx_sync(IDX_WAIT_PREVIEW)) return &job.preview_hdr;
+    return (max_entry_cnt > 0) ? &idx_cur->hdr : NULL;
+}
+
+// Discard the published index (core0)
 static void idx_sort_delete(void)
 {
-    free(entry_list);
-    free(sorted_flg);
-    free(fast_fname_list);
-    free(is_file_flg);
+    idx_job_cancel();
+    if (max_entry_cnt > 0) idx_lru_put(idx_cur);
+    io_lock(IO_REQ_DIR);
+    idx_delete(idx_cur);
+    io_unlock(IO_REQ_DIR);
+    max_entry_cnt = 0;
 }
 
 //==============================
@@ -363,96 +1218,56 @@ FRESULT file_menu_init(uint8_t* fs_type)
 
     pico_fatfs_set_config(&config);
     for (int i = 0; i < 5; i++) {
-        fr = f_mount(&fs, "", 1); // fr: 0: mount successful, 1: mount failed
+        fr = io_f_mount(IO_REQ_DIR, &fs, "", 1); // fr: 0: mount successful, 1: mount failed
         if (fr == FR_OK) {
             *fs_type = fs.fs_type;
             break;
         }
         pico_fatfs_reboot_spi();
     }
+    io_set_idle_task(file_menu_idle);
     return fr;
 }
 
 FRESULT file_menu_deinit()
 {
-    FRESULT fr = f_unmount("");
+    io_set_idle_task(NULL);
+    idx_sort_delete();
+    idx_lru_clear(); // the card could be changed
+    FRESULT fr = io_f_unmount(IO_REQ_DIR, "");
     pico_fatfs_reboot_spi();
     return fr;
 }
 
-// For implicit sort all entries
-void file_menu_idle(void)
+// Background sort (core1 while audio streams need no read)
+bool file_menu_idle(bool may_write)
 {
-    static int up_down = 0;
-    uint16_t r_start = 0;
-    uint16_t r_end_1 = 0;
-    if (get_range_full_sorted(0, max_entry_cnt)) return;
-    for (;;) {
-        if (up_down & 0x1) {
-            r_start = last_order + 1;
-            while (get_range_full_sorted(last_order, r_start) && r_start < max_entry_cnt) {
-                r_start++;
-            }
-            r_start--;
-            r_end_1 = r_start + 1;
-            while (get_range_full_unsorted(r_start, r_end_1) && r_end_1 <= max_entry_cnt && r_end_1 - r_start <= 5) {
-                r_end_1++;
-            }
-            r_end_1--;
-            up_down++;
-        } else {
-            if (last_order > 0) {
-                r_end_1 = last_order - 1;
-                while (get_range_full_sorted(r_end_1, last_order+1) && r_end_1 != 0) {
-                    r_end_1--;
-                }
-                r_end_1++;
-                r_start = r_end_1 - 1;
-                while (get_range_full_unsorted(r_start, r_end_1) && r_start != 0 && r_end_1 - r_start <= 5) {
-                    r_start--;
-                }               
-            }
-            up_down++;
-        }
-        break;
-    }
-    
-    #ifdef DEBUG_FILE_MENU
-    printf("implicit sort %d %d\n\r", r_start, r_end_1);
-    #endif // #ifdef DEBUG_FILE_MENU
-    idx_qsort_entry_list_by_range(r_start, r_end_1, 0, max_entry_cnt);
+    return idx_job_step(may_write);
 }
 
-void file_menu_sort_entry(uint16_t scope_start, uint16_t scope_end_1)
+int file_menu_is_ready(uint32_t scope_end_1)
 {
-    uint16_t wing;
-    uint16_t wing_start, wing_end_1;
-    if (scope_start >= scope_end_1) return;
-    if (scope_start > max_entry_cnt - 1) scope_start = max_entry_cnt - 1;
-    if (scope_end_1 > max_entry_cnt) scope_end_1 = max_entry_cnt;
-    wing = (scope_end_1 - scope_start)*2;
-    wing_start = (scope_start > wing) ? scope_start - wing : 0;
-    wing = (scope_end_1 - scope_start)*4 - (scope_start - wing_start);
-    wing_end_1 = (scope_end_1 + wing < max_entry_cnt) ? scope_end_1 + wing : max_entry_cnt;
-    //printf("scope_start %d %d %d %d\n\r", scope_start, scope_end_1, wing_start, wing_end_1);
-    if (!get_range_full_sorted(scope_start, scope_end_1)) {
-        idx_qsort_entry_list_by_range(wing_start, wing_end_1, 0, max_entry_cnt);
-    }
+    if (idx_sync(IDX_NO_WAIT)) return 1;
+    return job.preview && (scope_end_1 <= job.top_num + 1 || job.top_num == job.preview_hdr.num);
 }
 
 void file_menu_full_sort(void)
 {
-    file_menu_sort_entry(0, max_entry_cnt);
+    idx_sync(IDX_WAIT_ALL);
 }
 
-TCHAR* file_menu_get_fname_ptr(uint16_t order)
+TCHAR* file_menu_get_fname_ptr(uint32_t order)
 {
     FRESULT fr = FR_INVALID_PARAMETER;     /* FatFs return code */
-    file_menu_sort_entry(order, order+5);
-    if (order < max_entry_cnt) {
-        fr = idx_f_stat(entry_list[order], &fno);
-        last_order = order;
-
+    const idx_rec_t* rec_ptr;
+    if (order == 0) {
+        strncpy(fno.fname, "..", FF_LFN_BUF);
+        fr = FR_OK;
+    } else if ((rec_ptr = idx_get_order_rec(order)) != NULL) {
+        idx_rec_t rec = *rec_ptr;
+        io_lock(IO_REQ_DIR);
+        fr = idx_read_entry(&dir, &rec, &fno);
+        io_unlock(IO_REQ_DIR);
     }
     if (fr == FR_OK) {
         return fno.fname;
@@ -461,118 +1276,152 @@ TCHAR* file_menu_get_fname_ptr(uint16_t order)
     }
 }
 
-FRESULT file_menu_get_fname(uint16_t order, char* str, uint16_t size)
+FRESULT file_menu_get_fname(uint32_t order, char* str, uint16_t size)
 {
     FRESULT fr = FR_INVALID_PARAMETER;     /* FatFs return code */
-    file_menu_sort_entry(order, order+5);
-    if (order < max_entry_cnt) {
-        fr = idx_f_stat(entry_list[order], &fno);
-        strncpy(str, fno.fname, size);
-        last_order = order;
+    if (order < file_menu_get_num()) {
+        TCHAR* fname = file_menu_get_fname_ptr(order);
+        strncpy(str, fname, size);
+        fr = (fname[0] != '\0') ? FR_OK : FR_INT_ERR;
     }
     return fr;
 }
 
-int file_menu_is_dir(uint16_t order)
+int file_menu_is_dir(uint32_t order)
 {
-    if (order < max_entry_cnt) {
-        return !get_is_file(entry_list[order]);
+    const idx_rec_t* rec;
+    if (order == 0) {
+        return 1;
+    } else if ((rec = idx_get_order_rec(order)) != NULL) {
+        return !(rec->info & REC_IS_FILE);
     } else {
         return -1;
     }
 }
 
-uint16_t file_menu_get_num(void)
+uint32_t file_menu_get_num(void)
+{
+    const idx_header_t* hdr = idx_get_hdr();
+    return (hdr != NULL) ? hdr->num + 1 : 0;
+}
+
+uint32_t file_menu_get_dir_num(void)
+{
+    const idx_header_t* hdr = idx_get_hdr();
+    return (hdr != NULL) ? hdr->dir_num : 0;
+}
+
+uint32_t file_menu_get_hash(void)
 {
-    return max_entry_cnt;
+    const idx_header_t* hdr = idx_get_hdr();
+    return (hdr != NULL) ? hdr->hash : 0;
 }
 
-uint16_t file_menu_get_dir_num(void)
+// Same as file_menu_get_hash() of the directory, but read through without sort
+uint32_t file_menu_get_dir_hash(const TCHAR* path)
 {
-    uint16_t count = 0;
-    for (int i = 1; i < max_entry_cnt; i++) {
-        if (file_menu_is_dir(i) > 0) { count++; }
+    DIR dp;
+    FILINFO fi;
+    uint32_t hash = IDX_HASH_SEED;
+    if (io_f_opendir(IO_REQ_DIR, &dp, path) != FR_OK) return 0;
+    while (io_f_readdir(IO_REQ_DIR, &dp, &fi) == FR_OK && fi.fname[0] != '\0') {
+        if (idx_is_target(&fi)) hash = idx_hash_entry(hash, &fi);
     }
-    return count;
+    io_f_closedir(IO_REQ_DIR, &dp);
+    return hash;
 }
 
-int file_menu_match_ext(uint16_t order, const char* ext, size_t ext_size)
+void file_menu_set_ext_type(const char* ext, file_menu_type_t type)
 {
-    char name[FF_MAX_LFN];
-    file_menu_get_fname(order, name, sizeof(name));
-    char* ext_pos = strrchr(name, '.');
-    if (ext_pos) {
-        if (strncmp(ext_pos+1, ext, ext_size) == 0) { return 1; }
+    idx_lru_clear(); // classified by the former types
+    for (int i = 0; i < ext_type_num; i++) {
+        if (strcasecmp(ext, ext_type_list[i].ext) == 0) {
+            ext_type_list[i].type = type;
+            return;
+        }
     }
-    return 0;
+    if (ext_type_num >= EXT_TYPE_MAX || strlen(ext) >= EXT_SZ) return;
+    strncpy(ext_type_list[ext_type_num].ext, ext, EXT_SZ);
+    ext_type_list[ext_type_num].type = type;
+    ext_type_num++;
 }
 
-uint16_t file_menu_get_ext_num(const char* ext, size_t ext_size)
+int file_menu_is_type(uint32_t order, file_menu_type_t type)
 {
-    return file_menu_get_ext_num_from_max(ext, ext_size, max_entry_cnt);
+    const idx_rec_t* rec;
+    if (order == 0) return type == FILE_MENU_TYPE_OTHER;
+    if ((rec = idx_get_order_rec(order)) == NULL) return 0;
+    return rec_get_type(rec) == type;
 }
 
-uint16_t file_menu_get_ext_num_from_max(const char* ext, size_t ext_size, uint16_t max_order)
+uint32_t file_menu_get_type_num(file_menu_type_t type)
 {
-    uint16_t count = 0;
-    for (int i = 1; i < max_order; i++) {
-        if (file_menu_match_ext(i, ext, ext_size)) { count++; }
-        /*
-        file_menu_get_fname(i, name, sizeof(name));
-        char* ext_pos = strrchr(name, '.');
-        if (ext_pos) {
-            if (strncmp(ext_pos+1, ext, ext_size) == 0) { count++; }
-        }
-        */
+    const idx_header_t* hdr = idx_get_hdr();
+    return (hdr != NULL) ? hdr->type_num[type] : 0;
+}
+
+uint32_t file_menu_get_type_num_from_max(file_menu_type_t type, uint32_t max_order)
+{
+    uint32_t count;
+    uint32_t num; // records before max_order
+    idx_sync(IDX_WAIT_ALL);
+    if (max_order > max_entry_cnt) max_order = max_entry_cnt;
+    if (max_order == 0) return 0;
+    if (max_order == max_entry_cnt) return idx_cur->hdr.type_num[type];
+    num = max_order - 1;
+    count = (type == FILE_MENU_TYPE_OTHER) ? 1 : 0; // ".."
+    if (idx_cur->type_prefix[type] == NULL) return count;
+    count += idx_cur->type_prefix[type][num / IDX_PREFIX_STRIDE];
+    for (uint32_t i = num / IDX_PREFIX_STRIDE * IDX_PREFIX_STRIDE; i < num; i++) {
+        if (rec_get_type(idx_get_rec(i)) == type) count++;
     }
     return count;
 }
 
+void file_menu_get_stats(file_menu_stats_t* stats)
+{
+    idx_sync(IDX_NO_WAIT);
+    *stats = idx_cur->stats;
+    stats->lru_hits = idx_lru_hits;
+    stats->lru_lookups = idx_lru_lookups;
+    stats->lru_bytes = idx_lru_bytes;
+}
+
 FRESULT file_menu_open_dir(const TCHAR* path)
 {
     FRESULT fr = FR_INVALID_PARAMETER;     /* FatFs return code */
+    idx_sort_delete();
     //fr = f_opendir(&dir, path);
-    f_chdir(path);
-    fr = f_opendir(&dir, ".");
-    f_stat_cnt = 1;
-    last_order = 0;
+    io_f_chdir(IO_REQ_DIR, path);
+    fr = io_f_opendir(IO_REQ_DIR, &dir, ".");
     if (fr == FR_OK) {
-        idx_sort_new();
+        idx_job_start();
     }
     return fr;
 }
 
-FRESULT file_menu_ch_dir(uint16_t order)
+FRESULT file_menu_ch_dir(uint32_t order)
 {
     FRESULT fr = FR_INVALID_PARAMETER;     /* FatFs return code */
-    if (order < max_entry_cnt) {
-        fr = idx_f_stat(entry_list[order], &fno);
-        f_closedir(&dir);
-        //printf("chdir %s\n\r", fno.fname);
-        f_chdir(fno.fname);
-        fr = f_opendir(&dir, ".");
+    if (order < file_menu_get_num()) {
+        TCHAR* fname = file_menu_get_fname_ptr(order);
         idx_sort_delete();
+        io_f_closedir(IO_REQ_DIR, &dir);
+        //printf("chdir %s\n\r", fname);
+        io_f_chdir(IO_REQ_DIR, fname);
+        fr = io_f_opendir(IO_REQ_DIR, &dir, ".");
     }
-    f_stat_cnt = 1;
-    last_order = 0;
     //fr = f_opendir(&dir, path);
     //f_chdir(path);
     //fr = f_opendir(&dir, ".");
     if (fr == FR_OK) {
-        idx_sort_new();
+        idx_job_start();
     }
     return fr;
 }
 
 void file_menu_close_dir(void)
 {
-    /*
-    for (int i = 0; i < max_entry_cnt; i++) {
-        char temp_str[5] = "    ";
-        strncpy(temp_str, fast_fname_list[i], 4);
-        printf("fast_fname_list[%d] = %4s\r\n", i, temp_str);
-    }
-    */
     idx_sort_delete();
-    f_closedir(&dir);
+    io_f_closedir(IO_REQ_DIR, &dir);
 }
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "ff.h"
@@ -16,22 +17,50 @@
 extern "C" {
 #endif
 
+// File type classified by extension when the directory is opened
+typedef enum {
+    FILE_MENU_TYPE_OTHER = 0,  // including directories
+    FILE_MENU_TYPE_AUDIO,
+    FILE_MENU_TYPE_IMAGE,
+    FILE_MENU_NUM_TYPES
+} file_menu_type_t;
+
+typedef struct {
+    uint32_t num;        // entries including ".."
+    uint32_t runs;       // sorted runs spilled to the card and merged (0: sorted in RAM)
+    uint32_t full_cmps;  // comparisons which needed full names read from the card
+    uint32_t preview_ms; // time until the first page is available
+    uint32_t sort_ms;    // time to build or load the index
+    uint32_t ram_bytes;  // RAM held by the index
+    uint32_t peak_bytes; // RAM used while building the index
+    int cache_hit;       // loaded from the index file
+    int lru_hit;         // reused from recently visited directories
+    int paged;           // records are paged from the index file
+    uint32_t lru_hits;   // directories reused from recently visited ones since mount
+    uint32_t lru_lookups;
+    uint32_t lru_bytes;  // RAM held by recently visited directories
+} file_menu_stats_t;
+
 FRESULT file_menu_init(uint8_t* fs_type);
 FRESULT file_menu_deinit();
 FRESULT file_menu_open_dir(const TCHAR* path);
-FRESULT file_menu_ch_dir(uint16_t order);
+FRESULT file_menu_ch_dir(uint32_t order);
 void file_menu_close_dir(void);
-uint16_t file_menu_get_num(void);
-uint16_t file_menu_get_dir_num(void);
-int file_menu_match_ext(uint16_t order, const char* ext, size_t ext_size); // ext: "mp3", "wav" (ext does not include ".")
-uint16_t file_menu_get_ext_num(const char* ext, size_t ext_size); // ext: "mp3", "wav" (ext does not include ".")
-uint16_t file_menu_get_ext_num_from_max(const char* ext, size_t ext_size, uint16_t max_order); // ext: "mp3", "wav" (ext does not include ".")
+int file_menu_is_ready(uint32_t scope_end_1); // entries in [0, scope_end_1) are available without wait
+uint32_t file_menu_get_num(void);
+uint32_t file_menu_get_dir_num(void);
+uint32_t file_menu_get_hash(void); // signature of the directory (names, attributes, sizes and timestamps of the entries)
+uint32_t file_menu_get_dir_hash(const TCHAR* path); // file_menu_get_hash() of the directory without opening it (0: not found)
+void file_menu_set_ext_type(const char* ext, file_menu_type_t type); // ext: "wav", "jpg" (case-insensitive), effective from next directory open
+int file_menu_is_type(uint32_t order, file_menu_type_t type);
+uint32_t file_menu_get_type_num(file_menu_type_t type);
+uint32_t file_menu_get_type_num_from_max(file_menu_type_t type, uint32_t max_order); // number of the type in [0, max_order)
 void file_menu_full_sort(void);
-void file_menu_sort_entry(uint16_t scope_start, uint16_t scope_end_1);
-FRESULT file_menu_get_fname(uint16_t order, char* str, uint16_t size);
-TCHAR* file_menu_get_fname_ptr(uint16_t order);
-int file_menu_is_dir(uint16_t order);
-void file_menu_idle(void);
+FRESULT file_menu_get_fname(uint32_t order, char* str, uint16_t size);
+TCHAR* file_menu_get_fname_ptr(uint32_t order);
+int file_menu_is_dir(uint32_t order);
+bool file_menu_idle(bool may_write); // a step of background sort, returns true if done (called on core1 by io_service)
+void file_menu_get_stats(file_menu_stats_t* stats);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,121 @@
+/*-----------------------------------------------------------/
+/ file_menu_coll: collation of file names for file_menu
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#include "file_menu_coll.h"
+
+#include <string.h>
+#include <strings.h>
+
+typedef struct {
+    const uint8_t* ptr;
+    uint8_t buf[4];
+    int len;
+    int pos;
+    int digits; // remaining digits to output as is
+} coll_t;
+
+uint32_t coll_fold(uint32_t c)
+{
+    if (c >= 'A' && c <= 'Z') return c + 0x20;
+    if (c < 0x80) return c;
+    if (c >= 0x00C0 && c <= 0x00DE && c != 0x00D7) return c + 0x20; // Latin-1
+    if (c >= 0x0100 && c <= 0x017F) { // Latin Extended-A
+        if (c == 0x0130 || c == 0x0131 || c == 0x0138 || c == 0x0149 || c == 0x017F) return c;
+        if (c == 0x0178) return 0x00FF;
+        if ((c >= 0x0139 && c <= 0x0148) || (c >= 0x0179 && c <= 0x017E)) return (c & 1) ? c + 1 : c;
+        return (c & 1) ? c : c + 1;
+    }
+    if (c >= 0x0391 && c <= 0x03AB && c != 0x03A2) return c + 0x20; // Greek
+    if (c >= 0x0410 && c <= 0x042F) return c + 0x20; // Cyrillic
+    if (c >= 0x0400 && c <= 0x040F) return c + 0x50;
+    if (c >= 0xFF21 && c <= 0xFF3A) return c + 0x20; // Fullwidth Latin
+    return c;
+}
+
+static void coll_init(coll_t* coll, const char* str)
+{
+    if (strncasecmp(str, "The ", 4) == 0) str += 4;
+    coll->ptr = (const uint8_t*) str;
+    coll->len = 0;
+    coll->pos = 0;
+    coll->digits = 0;
+}
+
+// Next collation byte (0: end)
+static uint8_t coll_next(coll_t* coll)
+{
+    const uint8_t* p = coll->ptr;
+    uint32_t c;
+    int n;
+    if (coll->pos < coll->len) return coll->buf[coll->pos++];
+    if (coll->digits > 0) {
+        coll->digits--;
+        return *coll->ptr++;
+    }
+    if (*p == '\0') return 0;
+    coll->pos = 0;
+    coll->len = 0;
+    if (*p >= '0' && *p <= '9') {
+        while (*p == '0') p++;
+        for (n = 0; p[n] >= '0' && p[n] <= '9'; n++) {}
+        coll->buf[coll->len++] = (n < 9) ? '0' + n : '9';
+        if (n >= 9) coll->buf[coll->len++] = (n < 255) ? n : 255;
+        coll->digits = n;
+        coll->ptr = p;
+        return coll->buf[coll->pos++];
+    }
+    // decode UTF-8 (invalid byte is passed through as is)
+    if (*p < 0x80) {
+        c = *p; n = 1;
+    } else if ((*p & 0xE0) == 0xC0 && (p[1] & 0xC0) == 0x80) {
+        c = ((p[0] & 0x1F) << 6) | (p[1] & 0x3F); n = 2;
+    } else if ((*p & 0xF0) == 0xE0 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80) {
+        c = ((p[0] & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F); n = 3;
+    } else {
+        coll->ptr = p + 1;
+        return *p;
+    }
+    coll->ptr = p + n;
+    c = coll_fold(c);
+    if (c < 0x80) {
+        coll->buf[coll->len++] = c;
+    } else if (c < 0x800) {
+        coll->buf[coll->len++] = 0xC0 | (c >> 6);
+        coll->buf[coll->len++] = 0x80 | (c & 0x3F);
+    } else {
+        coll->buf[coll->len++] = 0xE0 | (c >> 12);
+        coll->buf[coll->len++] = 0x80 | ((c >> 6) & 0x3F);
+        coll->buf[coll->len++] = 0x80 | (c & 0x3F);
+    }
+    return coll->buf[coll->pos++];
+}
+
+void coll_key(const char* str, uint8_t* key)
+{
+    coll_t coll;
+    coll_init(&coll, str);
+    for (int i = 0; i < COLL_KEY_SZ; i++) {
+        key[i] = coll_next(&coll);
+    }
+}
+
+// Full comparison in collation order, ties are broken by bytewise comparison
+int32_t coll_strcmp(const char* str1, const char* str2)
+{
+    coll_t coll1, coll2;
+    uint8_t c1, c2;
+    coll_init(&coll1, str1);
+    coll_init(&coll2, str2);
+    do {
+        c1 = coll_next(&coll1);
+        c2 = coll_next(&coll2);
+        if (c1 != c2) return (int32_t) c1 - c2;
+    } while (c1 != 0);
+    return strcmp(str1, str2);
+}
+
@@ -0,0 +1,34 @@
+/*-----------------------------------------------------------/
+/ file_menu_coll: collation of file names for file_menu
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Case-insensitive natural order
+// Name is converted to the sequence of collation bytes, which is compared bytewise:
+//   leading "The " is skipped
+//   each character is case-folded and encoded in UTF-8 (order of code point is kept)
+//   each run of digits is encoded by its length (leading zeros excluded) followed by the digits
+//     '0'+len (len < 9) or '9', len (len >= 9), so that longer number comes later
+// Fixed size head of it is kept for each entry as collation key.
+// Collation key never includes 0 except padding after the end.
+
+#define COLL_KEY_SZ 12
+
+uint32_t coll_fold(uint32_t c); // simple case folding of a code point
+void coll_key(const char* str, uint8_t* key); // key[COLL_KEY_SZ]
+int32_t coll_strcmp(const char* str1, const char* str2); // full comparison, ties are broken by bytewise comparison
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,275 @@
+/*-----------------------------------------------------------/
+/ io_service: FatFs access arbitration between core0 and core1
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#include "io_service.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/sync.h"
+#include "pico/stdlib.h"
+
+static spin_lock_t* io_spin_lock = NULL;
+static volatile int io_owner = -1;  // -1: free
+static volatile uint32_t io_audio_waiting = 0;
+static volatile bool io_audio_pending = false;  // claimed by failed io_try_lock()
+static uint32_t io_pending_since = 0;
+static io_stats_t io_stats[IO_NUM_REQUESTERS];
+static volatile io_idle_task_t io_idle_task = NULL;
+static const char* const io_req_name[IO_NUM_REQUESTERS] = {"audio", "dir", "meta", "image"};
+
+void io_service_init(void)
+{
+    if (io_spin_lock != NULL) { return; }
+    io_spin_lock = spin_lock_init(spin_lock_claim_unused(true));
+    memset(io_stats, 0, sizeof(io_stats));
+}
+
+// called with io_spin_lock held
+static void io_record_wait(io_req_t req, uint32_t wait)
+{
+    io_stats_t* st = &io_stats[req];
+    st->count++;
+    st->total_wait_us += wait;
+    if (wait > st->max_wait_us) { st->max_wait_us = wait; }
+}
+
+static inline bool io_is_available(io_req_t req)
+{
+    return io_owner < 0 && (req == IO_REQ_AUDIO || (io_audio_waiting == 0 && !io_audio_pending));
+}
+
+void io_lock(io_req_t req)
+{
+    uint32_t t0 = time_us_32();
+    uint32_t save;
+    if (req == IO_REQ_AUDIO) {
+        save = spin_lock_blocking(io_spin_lock);
+        io_audio_waiting++;
+        spin_unlock(io_spin_lock, save);
+    }
+    while (1) {
+        save = spin_lock_blocking(io_spin_lock);
+        if (io_is_available(req)) {
+            io_owner = (int) req;
+            if (req == IO_REQ_AUDIO) { io_audio_waiting--; }
+            io_record_wait(req, time_us_32() - t0);
+            spin_unlock(io_spin_lock, save);
+            break;
+        }
+        spin_unlock(io_spin_lock, save);
+        __wfe();  // woken by __sev() in io_unlock()
+    }
+}
+
+bool io_try_lock(io_req_t req)
+{
+    uint32_t now = time_us_32();
+    uint32_t save = spin_lock_blocking(io_spin_lock);
+    bool acquired = io_is_available(req);
+    bool wasPending = io_audio_pending;
+    if (acquired) {
+        io_owner = (int) req;
+        io_record_wait(req, (req == IO_REQ_AUDIO && wasPending) ? now - io_pending_since : 0);
+    }
+    if (req == IO_REQ_AUDIO) {
+        if (!acquired && !wasPending) { io_pending_since = now; }
+        io_audio_pending = !acquired;
+    }
+    spin_unlock(io_spin_lock, save);
+    return acquired;
+}
+
+void io_cancel(io_req_t req)
+{
+    if (req != IO_REQ_AUDIO) { return; }
+    uint32_t save = spin_lock_blocking(io_spin_lock);
+    io_audio_pending = false;
+    spin_unlock(io_spin_lock, save);
+    __sev();
+}
+
+void io_unlock(io_req_t req)
+{
+    uint32_t save = spin_lock_blocking(io_spin_lock);
+    if (io_owner == (int) req) { io_owner = -1; }
+    spin_unlock(io_spin_lock, save);
+    __sev();
+}
+
+void io_set_idle_task(io_idle_task_t task)
+{
+    io_idle_task = task;
+    __sev();
+}
+
+bool io_run_idle_task(bool may_write)
+{
+    io_idle_task_t task = io_idle_task;
+    return task != NULL && task(may_write);
+}
+
+void io_get_stats(io_req_t req, io_stats_t* stats)
+{
+    uint32_t save = spin_lock_blocking(io_spin_lock);
+    *stats = io_stats[req];
+    spin_unlock(io_spin_lock, save);
+}
+
+void io_print_stats(void)
+{
+    for (int i = 0; i < IO_NUM_REQUESTERS; i++) {
+        io_stats_t st;
+        io_get_stats((io_req_t) i, &st);
+        if (st.count == 0) { continue; }
+        printf("IO::%s %lu calls, wait avg %lu us, max %lu us\r\n", io_req_name[i], (unsigned long) st.count,
+            (unsigned long) (st.total_wait_us / st.count), (unsigned long) st.max_wait_us);
+    }
+}
+
+FRESULT io_f_mount(io_req_t req, FATFS* fs, const TCHAR* path, BYTE opt)
+{
+    io_lock(req);
+    FRESULT fr = f_mount(fs, path, opt);
+    io_unlock(req);
+    return fr;
+}
+
+FRESULT io_f_unmount(io_req_t req, const TCHAR* path)
+{
+    return io_f_mount(req, 0, path, 0);
+}
+
+FRESULT io_f_open(io_req_t req, FIL* fp, const TCHAR* path, BYTE mode)
+{
+    io_lock(req);
+    FRESULT fr = f_open(fp, path, mode);
+    io_unlock(req);
+    return fr;
+}
+
+FRESULT io_f_close(io_req_t req, FIL* fp)
+{
+    io_lock(req);
+    FRESULT fr = f_close(fp);
+    io_unlock(req);
+    return fr;
+}
+
+// read other than audio is split into chunks not to block audio stream for long
+FRESULT io_f_read(io_req_t req, FIL* fp, void* buff, UINT btr, UINT* br)
+{
+    FRESULT fr = FR_OK;
+    BYTE* ptr = (BYTE*) buff;
+    UINT chunk = (req == IO_REQ_AUDIO) ? btr : IO_CHUNK_SIZE;
+    *br = 0;
+    while (btr > 0) {
+        UINT n = (btr < chunk) ? btr : chunk;
+        UINT r = 0;
+        io_lock(req);
+        fr = f_read(fp, ptr, n, &r);
+        io_unlock(req);
+        *br += r;
+        ptr += r;
+        btr -= r;
+        if (fr != FR_OK || r < n) { break; }
+    }
+    return fr;
+}
+
+FRESULT io_f_write(io_req_t req, FIL* fp, const void* buff, UINT btw, UINT* bw)
+{
+    FRESULT fr = FR_OK;
+    const BYTE* ptr = (const BYTE*) buff;
+    UINT chunk = (req == IO_REQ_AUDIO) ? btw : IO_CHUNK_SIZE;
+    *bw = 0;
+    while (btw > 0) {
+        UINT n = (btw < chunk) ? btw : chunk;
+        UINT w = 0;
+        io_lock(req);
+        fr = f_write(fp, ptr, n, &w);
+        io_unlock(req);
+        *bw += w;
+        ptr += w;
+        btw -= w;
+        if (fr != FR_OK || w < n) { break; }
+    }
+    return fr;
+}
+
+FRESULT io_f_unlink(io_req_t req, const TCHAR* path)
+{
+    io_lock(req);
+    FRESULT fr = f_unlink(path);
+    io_unlock(req);
+    return fr;
+}
+
+FRESULT io_f_rename(io_req_t req, const TCHAR* path_old, const TCHAR* path_new)
+{
+    io_lock(req);
+    FRESULT fr = f_rename(path_old, path_new);
+    io_unlock(req);
+    return fr;
+}
+
+FRESULT io_f_chmod(io_req_t req, const TCHAR* path, BYTE attr, BYTE mask)
+{
+    io_lock(req);
+    FRESULT fr = f_chmod(path, attr, mask);
+    io_unlock(req);
+    return fr;
+}
+
+FRESULT io_f_lseek(io_req_t req, FIL* fp, FSIZE_t ofs)
+{
+    io_lock(req);
+    FRESULT fr = f_lseek(fp, ofs);
+    io_unlock(req);
+    return fr;
+}
+
+FRESULT io_f_opendir(io_req_t req, DIR* dp, const TCHAR* path)
+{
+    io_lock(req);
+    FRESULT fr = f_opendir(dp, path);
+    io_unlock(req);
+    return fr;
+}
+
+FRESULT io_f_closedir(io_req_t req, DIR* dp)
+{
+    io_lock(req);
+    FRESULT fr = f_closedir(dp);
+    io_unlock(req);
+    return fr;
+}
+
+FRESULT io_f_readdir(io_req_t req, DIR* dp, FILINFO* fno)
+{
+    io_lock(req);
+    FRESULT fr = f_readdir(dp, fno);
+    io_unlock(req);
+    return fr;
+}
+
+FRESULT io_f_chdir(io_req_t req, const TCHAR* path)
+{
+    io_lock(req);
+    FRESULT fr = f_chdir(path);
+    io_unlock(req);
+    return fr;
+}
+
+DRESULT io_disk_read(io_req_t req, BYTE pdrv, BYTE* buff, LBA_t sector, UINT count)
+{
+    io_lock(req);
+    DRESULT dr = disk_read(pdrv, buff, sector, count);
+    io_unlock(req);
+    return dr;
+}
@@ -0,0 +1,82 @@
+/*-----------------------------------------------------------/
+/ io_service: FatFs access arbitration between core0 and core1
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ff.h"
+#include "diskio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// FatFs is not reentrant and all the requesters share one FATFS object and SPI bus.
+// Every file system access goes through io_*() which holds the lock per call.
+// Audio stream has strict priority: other requesters don't acquire the lock while audio is waiting,
+// and their reads are split into IO_CHUNK_SIZE so that audio waits for one chunk at most.
+// Don't call io_*() from IRQ handlers.
+
+#define IO_CHUNK_SIZE 4096
+
+// the player writes files on the card (directory index, album index) and hides them by f_chmod()
+#if FF_FS_READONLY || !FF_USE_CHMOD
+#error "FF_FS_READONLY = 0 and FF_USE_CHMOD = 1 are required in ffconf.h"
+#endif
+
+typedef enum {
+    IO_REQ_AUDIO = 0,  // audio stream (ReadBuffer, PlayAudio)
+    IO_REQ_DIR,        // directory listing (file_menu)
+    IO_REQ_META,       // tag (TagRead)
+    IO_REQ_IMAGE,      // cover art (JPEGDecoder)
+    IO_NUM_REQUESTERS
+} io_req_t;
+
+// Idle task runs on core1 while no audio stream needs read, at lower priority than audio.
+// It must not wait for the lock (use io_try_lock()), and returns true if it did some work.
+// may_write is false while an audio stream is filling, then it must not write the card (which can stall the card for long).
+typedef bool (*io_idle_task_t)(bool may_write);
+
+// wait to acquire the lock per requester, updated under the spin lock
+typedef struct {
+    uint32_t count;
+    uint32_t max_wait_us;
+    uint64_t total_wait_us;
+} io_stats_t;
+
+void io_service_init(void);
+void io_lock(io_req_t req);
+bool io_try_lock(io_req_t req);  // failure of audio keeps priority claim until acquired or io_cancel()
+void io_cancel(io_req_t req);
+void io_unlock(io_req_t req);
+void io_set_idle_task(io_idle_task_t task);
+bool io_run_idle_task(bool may_write);
+void io_get_stats(io_req_t req, io_stats_t* stats);
+void io_print_stats(void);
+
+FRESULT io_f_mount(io_req_t req, FATFS* fs, const TCHAR* path, BYTE opt);
+FRESULT io_f_unmount(io_req_t req, const TCHAR* path);
+FRESULT io_f_open(io_req_t req, FIL* fp, const TCHAR* path, BYTE mode);
+FRESULT io_f_close(io_req_t req, FIL* fp);
+FRESULT io_f_read(io_req_t req, FIL* fp, void* buff, UINT btr, UINT* br);
+FRESULT io_f_write(io_req_t req, FIL* fp, const void* buff, UINT btw, UINT* bw);
+FRESULT io_f_unlink(io_req_t req, const TCHAR* path);
+FRESULT io_f_rename(io_req_t req, const TCHAR* path_old, const TCHAR* path_new);
+FRESULT io_f_chmod(io_req_t req, const TCHAR* path, BYTE attr, BYTE mask);
+FRESULT io_f_lseek(io_req_t req, FIL* fp, FSIZE_t ofs);
+FRESULT io_f_opendir(io_req_t req, DIR* dp, const TCHAR* path);
+FRESULT io_f_closedir(io_req_t req, DIR* dp);
+FRESULT io_f_readdir(io_req_t req, DIR* dp, FILINFO* fno);
+FRESULT io_f_chdir(io_req_t req, const TCHAR* path);
+DRESULT io_disk_read(io_req_t req, BYTE pdrv, BYTE* buff, LBA_t sector, UINT count);
+
+#ifdef __cplusplus
+}
+#endif
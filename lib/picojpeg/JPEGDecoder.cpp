@@ -40,6 +40,7 @@ Bodmer (24/1/17): Correct greyscale images, update examples
 
 #include <cstring>
 
+#include "io_service.h"
 #include "picojpeg.h"
 
 JPEGDecoder JpegDec;
@@ -79,7 +80,7 @@ uint8_t JPEGDecoder::pjpeg_need_bytes_callback(uint8_t* pBuf, uint8_t buf_size,
 	}
 
 	UINT br;
-	if (jpg_source == JPEG_SD_FILE) f_read(&g_fil, pBuf, n, &br);
+	if (jpg_source == JPEG_SD_FILE) io_f_read(IO_REQ_IMAGE, &g_fil, pBuf, n, &br);
 
 	*pBytes_actually_read = (uint8_t) br;
 	g_nInFileOfs += n;
@@ -211,7 +212,7 @@ int JPEGDecoder::read(void) {
 int JPEGDecoder::decodeSdFile(const char *jpgFile, const uint64_t pos, const size_t size, const uint8_t reduce){
 	FRESULT fr;
 
-	fr = f_open(&g_fil, (TCHAR *) jpgFile, FA_READ);
+	fr = io_f_open(IO_REQ_IMAGE, &g_fil, (TCHAR *) jpgFile, FA_READ);
 	if (fr != FR_OK) {
 		#ifdef DEBUG
 		printf("ERROR: SD file not found!\n");
@@ -226,7 +227,7 @@ int JPEGDecoder::decodeSdFile(const char *jpgFile, const uint64_t pos, const siz
 	if (pos == 0) {
 		g_nInFileSize = f_size(&g_fil);
 	} else {
-		fr = f_lseek(&g_fil, (FSIZE_t) pos);
+		fr = io_f_lseek(IO_REQ_IMAGE, &g_fil, (FSIZE_t) pos);
 		if (fr != FR_OK) {
 			#ifdef DEBUG
 			printf("ERROR: f_lseek failed\n");
@@ -315,5 +316,5 @@ void JPEGDecoder::abort(void) {
 	if(pImage) delete[] pImage;
 	pImage = NULL;
 	
-	if (jpg_source == JPEG_SD_FILE) f_close(&g_fil);
+	if (jpg_source == JPEG_SD_FILE) io_f_close(IO_REQ_IMAGE, &g_fil);
 }
@@ -0,0 +1,357 @@
+/*-----------------------------------------------------------/
+/ AlbumIndex.cpp
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#include "AlbumIndex.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "pico/stdlib.h"
+
+#include "file_menu_FatFs.h"
+#include "io_service.h"
+
+//=================================
+// Implementation of AlbumIndex class
+//=================================
+AlbumIndex& AlbumIndex::instance()
+{
+    static AlbumIndex instance; // Singleton
+    return instance;
+}
+
+bool AlbumIndex::prepare()
+{
+    if (!valid) { valid = update(); }
+    return valid;
+}
+
+void AlbumIndex::invalidate()
+{
+    valid = false;
+}
+
+uint32_t AlbumIndex::getNum() const
+{
+    return valid ? header.num : 0;
+}
+
+bool AlbumIndex::get(const uint32_t& idx, Album_t& album)
+{
+    Record_t rec;
+    if (!valid || idx >= header.num) { return false; }
+    if (io_f_open(IO_REQ_DIR, &fil, FileName, FA_READ) != FR_OK) { return false; }
+    bool result = readRecord(idx, rec, album.path);
+    io_f_close(IO_REQ_DIR, &fil);
+    if (!result) { return false; }
+    album.depth = rec.depth;
+    memcpy(album.orders, rec.orders, sizeof(album.orders));
+    return true;
+}
+
+void AlbumIndex::getRange(const uint32_t* orders, const uint32_t& depth, uint32_t& first, uint32_t& last)
+{
+    first = 0;
+    last = getNum();
+    if (depth == 0 || last == 0) { return; }
+    if (io_f_open(IO_REQ_DIR, &fil, FileName, FA_READ) != FR_OK) { first = last = 0; return; }
+    // binary search of the albums in the folder (depth-first order is lexicographic order of 'orders')
+    uint32_t lo = 0;
+    uint32_t hi = last;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (comparePrefix(mid, orders, depth) < 0) { lo = mid + 1; } else { hi = mid; }
+    }
+    first = lo;
+    hi = last;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (comparePrefix(mid, orders, depth) <= 0) { lo = mid + 1; } else { hi = mid; }
+    }
+    last = lo;
+    io_f_close(IO_REQ_DIR, &fil);
+}
+
+bool AlbumIndex::find(const uint32_t* orders, const uint32_t& depth, uint32_t& idx)
+{
+    Record_t rec;
+    uint32_t last;
+    getRange(orders, depth, idx, last);
+    if (idx >= last) { return false; }
+    if (io_f_open(IO_REQ_DIR, &fil, FileName, FA_READ) != FR_OK) { return false; }
+    bool result = readRecord(idx, rec, nullptr) && rec.depth == depth;
+    io_f_close(IO_REQ_DIR, &fil);
+    return result;
+}
+
+bool AlbumIndex::findDepth(const uint32_t& first, const uint32_t& last, const uint32_t& depth, uint32_t& idx)
+{
+    Record_t rec;
+    bool result = false;
+    if (!valid || first >= last) { return false; }
+    if (io_f_open(IO_REQ_DIR, &fil, FileName, FA_READ) != FR_OK) { return false; }
+    for (idx = first; idx < last && idx < header.num; idx++) {
+        if (!readRecord(idx, rec, nullptr)) { break; }
+        if (rec.depth == depth) { result = true; break; }
+    }
+    io_f_close(IO_REQ_DIR, &fil);
+    return result;
+}
+
+// Fisher-Yates shuffle a step at a time, the permutation is kept in the file to continue after power off
+bool AlbumIndex::shuffle(const uint32_t& first, const uint32_t& last, uint32_t& idx)
+{
+    if (!valid || first >= last) { return false; }
+    uint32_t n = last - first;
+    FSIZE_t permOfs = header.tableOfs + sizeof(uint32_t) * header.num;
+    bool result = true;
+    if (io_f_open(IO_REQ_DIR, &fil, FileName, FA_READ | FA_WRITE) != FR_OK) { return false; }
+    if (header.permFirst != first || header.permLast != last) {
+        // new range starts from identity permutation
+        uint32_t buf[32];
+        for (uint32_t i = 0; i < n && result; i += 32) {
+            uint32_t size = (n - i < 32) ? n - i : 32;
+            for (uint32_t j = 0; j < size; j++) { buf[j] = first + i + j; }
+            result = writeAt(fil, permOfs + sizeof(uint32_t) * i, buf, sizeof(uint32_t) * size);
+        }
+        header.permFirst = first;
+        header.permLast = last;
+        header.permPos = 0;
+    } else if (header.permPos >= n) {
+        header.permPos = 0; // all picked, next cycle goes on from the permutation as it is
+    }
+    uint32_t k = header.permPos;
+    uint32_t j = k + rand() % (n - k);
+    uint32_t vk, vj;
+    result = result && readAt(fil, permOfs + sizeof(uint32_t) * j, &vj, sizeof(vj));
+    if (result && k == 0 && n > 1 && vj == header.lastIdx) {
+        // don't repeat the last one of previous cycle
+        j = (j + 1 + rand() % (n - 1)) % n;
+        result = readAt(fil, permOfs + sizeof(uint32_t) * j, &vj, sizeof(vj));
+    }
+    result = result && readAt(fil, permOfs + sizeof(uint32_t) * k, &vk, sizeof(vk));
+    result = result && writeAt(fil, permOfs + sizeof(uint32_t) * j, &vk, sizeof(vk));
+    result = result && writeAt(fil, permOfs + sizeof(uint32_t) * k, &vj, sizeof(vj));
+    header.permPos++;
+    header.lastIdx = vj;
+    result = result && writeAt(fil, 0, &header, sizeof(header));
+    io_f_close(IO_REQ_DIR, &fil);
+    if (!result) {
+        header.permFirst = header.permLast = 0; // permutation is initialized again
+        return false;
+    }
+    idx = vj;
+    return true;
+}
+
+// Check the index file, and write it again if any folder changed
+bool AlbumIndex::update()
+{
+    UINT br;
+    FSIZE_t changed = 0; // walk from root
+    if (io_f_open(IO_REQ_DIR, &fil, FileName, FA_READ) == FR_OK) {
+        if (io_f_read(IO_REQ_DIR, &fil, &header, sizeof(header), &br) == FR_OK && br == sizeof(header) && header.magic == Magic) {
+            changed = check();
+            if (changed == 0) {
+                io_f_close(IO_REQ_DIR, &fil);
+                printf("Album Index: %lu albums loaded\r\n", static_cast<unsigned long>(header.num));
+                return true;
+            }
+        }
+        io_f_close(IO_REQ_DIR, &fil);
+    }
+    return build(changed) || (changed != 0 && build(0));
+}
+
+// Offset of the first folder changed since the index was built (0: none)
+// a folder whose signature is unchanged has the same child folders, then each of them is checked in turn
+// every folder is read through once, which takes time in proportion to the folders on the card (logged)
+FSIZE_t AlbumIndex::check()
+{
+    uint32_t t0 = to_ms_since_boot(get_absolute_time());
+    Record_t rec;
+    char path[PathSize];
+    uint32_t checked = 0;
+    FSIZE_t pos;
+    for (pos = sizeof(Header_t); pos < header.tableOfs; pos += sizeof(rec) + rec.pathLen) {
+        checked++;
+        if (!readNode(pos, rec, path) || file_menu_get_dir_hash(path) != rec.hash) { break; }
+    }
+    printf("Album Index: %lu folders checked, %lu ms\r\n", static_cast<unsigned long>(checked),
+        static_cast<unsigned long>(to_ms_since_boot(get_absolute_time()) - t0));
+    return (pos < header.tableOfs) ? pos : 0;
+}
+
+// Write the index into TmpFileName, then replace FileName with it
+// the records before 'changed' are copied, after that the subtree of each changed folder is walked again
+bool AlbumIndex::build(const FSIZE_t& changed)
+{
+    uint32_t t0 = to_ms_since_boot(get_absolute_time());
+    Record_t rec;
+    char path[PathSize] = "";
+    uint32_t walked = 0; // subtrees
+    bool result = true;
+
+    if (changed != 0 && io_f_open(IO_REQ_DIR, &fil, FileName, FA_READ) != FR_OK) { return false; }
+    if (io_f_open(IO_REQ_DIR, &tmpFil, TmpFileName, FA_READ | FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
+        if (changed != 0) { io_f_close(IO_REQ_DIR, &fil); }
+        return false;
+    }
+    io_f_chmod(IO_REQ_DIR, TmpFileName, AM_HID, AM_HID);
+    table.clear();
+    ofs = sizeof(Header_t);
+    if (changed == 0) {
+        uint32_t orders[MaxDepth] = {};
+        file_menu_open_dir("/");
+        walked++;
+        result = walk(0, orders, path);
+    } else {
+        bool skip = false; // in the subtree walked again
+        uint32_t skipDepth = 0;
+        for (FSIZE_t pos = sizeof(Header_t); result && pos < header.tableOfs; pos += sizeof(rec) + rec.pathLen) {
+            result = readNode(pos, rec, path);
+            if (!result || (skip && rec.depth > skipDepth)) { continue; }
+            skip = false;
+            if (pos < changed || file_menu_get_dir_hash(path) == rec.hash) {
+                result = put(rec, path);
+                continue;
+            }
+            // changed or removed
+            skip = true;
+            skipDepth = rec.depth;
+            if (file_menu_open_dir(path) == FR_OK) {
+                walked++;
+                if (rec.depth == 0) { path[0] = '\0'; }
+                result = walk(rec.depth, rec.orders, path);
+            }
+        }
+        io_f_close(IO_REQ_DIR, &fil);
+    }
+    memset(&header, 0, sizeof(header));
+    header.magic = Magic;
+    header.num = table.size();
+    header.tableOfs = ofs;
+    header.lastIdx = header.num; // none
+    result = result && writeAt(tmpFil, ofs, table.data(), sizeof(uint32_t) * table.size());
+    // room for the permutation
+    result = result && io_f_lseek(IO_REQ_DIR, &tmpFil, ofs + sizeof(uint32_t) * 2 * table.size()) == FR_OK;
+    result = result && writeAt(tmpFil, 0, &header, sizeof(header));
+    result = (io_f_close(IO_REQ_DIR, &tmpFil) == FR_OK) && result;
+    table.clear();
+    table.shrink_to_fit();
+    file_menu_open_dir("/");
+    if (result) {
+        io_f_unlink(IO_REQ_DIR, FileName);
+        result = io_f_rename(IO_REQ_DIR, TmpFileName, FileName) == FR_OK;
+    }
+    if (!result) {
+        printf("Album Index: write failed\r\n");
+        io_f_unlink(IO_REQ_DIR, TmpFileName);
+        return false;
+    }
+    printf("Album Index: %lu albums, %lu subtrees walked, %lu ms\r\n", static_cast<unsigned long>(header.num),
+        static_cast<unsigned long>(walked), static_cast<unsigned long>(to_ms_since_boot(get_absolute_time()) - t0));
+    return true;
+}
+
+// Depth-first walk from the folder opened by file_menu (directories come first in file_menu order)
+// names of the child folders are collected up to ChildBufSize at once, so that the folder is not scanned again for each child
+bool AlbumIndex::walk(const uint32_t& depth, uint32_t* orders, char* path)
+{
+    size_t len = strlen(path);
+    const char* folderPath = (len == 0) ? "/" : path;
+    Record_t rec;
+    rec.depth = depth;
+    rec.pathLen = strlen(folderPath);
+    rec.hash = file_menu_get_hash();
+    rec.audioNum = file_menu_get_type_num(FILE_MENU_TYPE_AUDIO);
+    memcpy(rec.orders, orders, sizeof(rec.orders));
+    if (!put(rec, folderPath)) { return false; }
+    if (depth >= MaxDepth) { return true; }
+    uint32_t dirNum = file_menu_get_dir_num();
+    std::vector<uint32_t> childOrders;
+    std::vector<char> childNames;
+    uint32_t order = 1;
+    while (order <= dirNum) {
+        childOrders.clear();
+        childNames.clear();
+        for (; order <= dirNum; order++) {
+            const char* name = file_menu_get_fname_ptr(order);
+            size_t size = strlen(name) + 1;
+            if (len + size >= PathSize) { continue; }
+            if (!childOrders.empty() && childNames.size() + size > ChildBufSize) { break; }
+            childOrders.push_back(order);
+            childNames.insert(childNames.end(), name, name + size);
+        }
+        const char* name = childNames.data();
+        for (const auto& childOrder : childOrders) {
+            path[len] = '/';
+            strcpy(&path[len+1], name);
+            name += strlen(name) + 1;
+            orders[depth] = childOrder;
+            if (file_menu_open_dir(path) == FR_OK && !walk(depth + 1, orders, path)) { return false; }
+        }
+        path[len] = '\0';
+        if (order <= dirNum) {
+            file_menu_open_dir(folderPath); // back by path because ".." is not reliable on exFAT
+        }
+    }
+    return true;
+}
+
+bool AlbumIndex::put(const Record_t& rec, const char* path)
+{
+    if (!writeAt(tmpFil, ofs, &rec, sizeof(rec)) || !writeAt(tmpFil, ofs + sizeof(rec), path, rec.pathLen)) { return false; }
+    if (rec.audioNum > 0) { table.push_back(ofs); }
+    ofs += sizeof(rec) + rec.pathLen;
+    return true;
+}
+
+bool AlbumIndex::readNode(const FSIZE_t& pos, Record_t& rec, char* path)
+{
+    if (!readAt(fil, pos, &rec, sizeof(rec)) || rec.depth > MaxDepth || rec.pathLen >= PathSize) { return false; }
+    if (path != nullptr) {
+        if (!readAt(fil, pos + sizeof(rec), path, rec.pathLen)) { return false; }
+        path[rec.pathLen] = '\0';
+    }
+    return true;
+}
+
+bool AlbumIndex::readRecord(const uint32_t& idx, Record_t& rec, char* path)
+{
+    uint32_t recOfs;
+    if (!readAt(fil, header.tableOfs + sizeof(uint32_t) * idx, &recOfs, sizeof(recOfs))) { return false; }
+    return readNode(recOfs, rec, path);
+}
+
+// Compare 'orders' of the album with the folder, returns 0 if the album is in the folder
+int AlbumIndex::comparePrefix(const uint32_t& idx, const uint32_t* orders, const uint32_t& depth)
+{
+    Record_t rec;
+    if (!readRecord(idx, rec, nullptr)) { return 1; }
+    for (uint32_t i = 0; i < depth; i++) {
+        if (i >= rec.depth) { return -1; } // parent of the folder
+        if (rec.orders[i] != orders[i]) { return (rec.orders[i] < orders[i]) ? -1 : 1; }
+    }
+    return 0;
+}
+
+bool AlbumIndex::readAt(FIL& fp, const FSIZE_t& ofs, void* buf, const UINT& size)
+{
+    UINT br;
+    if (io_f_lseek(IO_REQ_DIR, &fp, ofs) != FR_OK) { return false; }
+    return io_f_read(IO_REQ_DIR, &fp, buf, size, &br) == FR_OK && br == size;
+}
+
+bool AlbumIndex::writeAt(FIL& fp, const FSIZE_t& ofs, const void* buf, const UINT& size)
+{
+    UINT bw;
+    if (io_f_lseek(IO_REQ_DIR, &fp, ofs) != FR_OK) { return false; }
+    return io_f_write(IO_REQ_DIR, &fp, buf, size, &bw) == FR_OK && bw == size;
+}
@@ -0,0 +1,96 @@
+/*-----------------------------------------------------------/
+/ AlbumIndex.h
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ff.h"
+
+//=================================
+// Interface of AlbumIndex class
+//=================================
+// Folders which contain audio files over the card in depth-first order of file_menu,
+// so that the albums in a folder are a range of the index.
+// Every folder walked is kept in AlbumIndex::FileName with its signature (file_menu_get_hash()).
+// Once after mount (or when an album turned out to be stale), each folder is checked by its signature
+// and only the subtree of a changed folder is walked again.
+// Folders deeper than MaxDepth levels are not indexed: sequential play walks their sibling folders instead
+// (UIFileViewMode::siblingSearch()), and random play picks among the indexed albums only.
+class AlbumIndex
+{
+public:
+    static constexpr uint32_t MaxDepth = 5; // levels of dir_stack stored in flash
+    static constexpr uint32_t PathSize = 256;
+    static constexpr const char* FileName = "/.album.idx";
+    static constexpr const char* TmpFileName = "/.album.tmp";
+
+    typedef struct {
+        uint32_t depth;
+        uint32_t orders[MaxDepth]; // order of the folder in each level from root
+        char path[PathSize];
+    } Album_t;
+
+    static AlbumIndex& instance(); // Singleton
+
+    // load and update the index once after mount (file_menu is left at root if walked)
+    // it blocks the caller (first album search after mount) while every folder is checked, which is
+    // done in the foreground because the idle task of io_service is taken by the file_menu index job
+    bool prepare();
+    void invalidate(); // check again on next prepare()
+    uint32_t getNum() const;
+    bool get(const uint32_t& idx, Album_t& album);
+    void getRange(const uint32_t* orders, const uint32_t& depth, uint32_t& first, uint32_t& last); // albums in the folder
+    bool find(const uint32_t* orders, const uint32_t& depth, uint32_t& idx); // true if the folder is album, otherwise idx is the album next to it
+    bool findDepth(const uint32_t& first, const uint32_t& last, const uint32_t& depth, uint32_t& idx); // first album of 'depth' levels in [first, last)
+    bool shuffle(const uint32_t& first, const uint32_t& last, uint32_t& idx); // no repeat until all in [first, last) are picked
+
+private:
+    static constexpr uint32_t Magic = 0x32424c41; // "ALB2"
+    static constexpr size_t ChildBufSize = 2048; // names of the child folders collected at once by walk()
+    typedef struct {
+        uint32_t magic;
+        uint32_t num;
+        uint32_t tableOfs;  // end of records, offset of each album record follows, then the permutation for shuffle
+        uint32_t permFirst; // range of the permutation
+        uint32_t permLast;
+        uint32_t permPos;   // picked in the cycle
+        uint32_t lastIdx;   // picked last
+    } Header_t;
+    typedef struct {
+        uint16_t depth;
+        uint16_t pathLen;  // followed by the path
+        uint32_t hash;     // file_menu_get_hash() of the folder
+        uint32_t audioNum; // album if any
+        uint32_t orders[MaxDepth];
+    } Record_t;
+
+    AlbumIndex() = default;
+    ~AlbumIndex() = default;
+    AlbumIndex(const AlbumIndex&) = delete;
+    AlbumIndex& operator=(const AlbumIndex&) = delete;
+
+    bool update();
+    FSIZE_t check();
+    bool build(const FSIZE_t& changed);
+    bool walk(const uint32_t& depth, uint32_t* orders, char* path);
+    bool put(const Record_t& rec, const char* path);
+    bool readNode(const FSIZE_t& pos, Record_t& rec, char* path);
+    bool readRecord(const uint32_t& idx, Record_t& rec, char* path);
+    int comparePrefix(const uint32_t& idx, const uint32_t* orders, const uint32_t& depth);
+    static bool readAt(FIL& fp, const FSIZE_t& ofs, void* buf, const UINT& size);
+    static bool writeAt(FIL& fp, const FSIZE_t& ofs, const void* buf, const UINT& size);
+
+    FIL fil;
+    FIL tmpFil; // TmpFileName while building
+    Header_t header;
+    std::vector<uint32_t> table; // offset of each album record while building
+    uint32_t ofs; // end of records while building
+    bool valid = false; // checked since mount
+};
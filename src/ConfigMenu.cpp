@@ -12,6 +12,8 @@
 #include <cstdio>
 
 #include "LcdCanvas.h"
+#include "ReadBuffer.h"
+#include "SpectrumAnalyzer.h"
 #include "ui_control.h"
 
 //=================================
@@ -34,6 +36,21 @@ void hookDispRotation()
     lcd.switchToListView();
 }
 
+void hookDispPlayScreen()
+{
+    ConfigMenu& cfgMenu = ConfigMenu::instance();
+    LcdCanvas& lcd = LcdCanvas::instance();
+    uint32_t playScreen = cfgMenu.get(ConfigMenuId::DISPLAY_PLAY_SCREEN);
+    lcd.setPlayScreen(static_cast<uint8_t>(playScreen));
+    SpectrumAnalyzer::setEnabled(playScreen == 1);  // FFT runs only when its screen is selected
+}
+
+void hookPlayReadPolicy()
+{
+    ConfigMenu& cfgMenu = ConfigMenu::instance();
+    ReadBuffer::setFillPolicy(static_cast<ReadBuffer::FillPolicy_t>(cfgMenu.get(ConfigMenuId::PLAY_READ_POLICY)));
+}
+
 //=================================
 // Implementation of ConfigMenu class
 //=================================
@@ -23,9 +23,13 @@ enum class ConfigMenuId: uint32_t {
     DISPLAY_BACKLIGHT_LOW_LEVEL,
     DISPLAY_BACKLIGHT_HIGH_LEVEL,
     DISPLAY_TIME_TO_BACKLIGHT_LOW,
+    DISPLAY_PLAY_SCREEN,
     PLAY_TIME_TO_NEXT_PLAY,
     PLAY_NEXT_PLAY_ALBUM,
     PLAY_RANDOM_DIR_DEPTH,
+    PLAY_REPLAY_GAIN,
+    PLAY_CROSSFADE,
+    PLAY_READ_POLICY,
 };
 
 //=================================
@@ -33,6 +37,8 @@ enum class ConfigMenuId: uint32_t {
 //=================================
 void hookDispLcdConfig();
 void hookDispRotation();
+void hookDispPlayScreen();
+void hookPlayReadPolicy();
 
 //=================================
 // Interface of ConfigMenu class
@@ -54,6 +60,12 @@ public:
         Random
     } NextPlayAction_t;
 
+    typedef enum {
+        ReplayGainOff = 0,
+        ReplayGainTrack,
+        ReplayGainAlbum
+    } ReplayGain_t;
+
     typedef struct {
         const char* name;
         const int   value;
@@ -119,6 +131,10 @@ private:
         {"0 deg", 0},
         {"180 deg", 1},
     };
+    const std::vector<ConfigSel_t> selPlayScreen = {
+        {"Level Meter", 0},
+        {"Spectrum", 1},
+    };
     const std::vector<ConfigSel_t> selBacklightLevel = {
         {"16", 16},
         {"32", 32},
@@ -150,6 +166,23 @@ private:
         {"3", 3},
         {"4", 4},
     };
+    const std::vector<ConfigSel_t> selReplayGain = {
+        {"Off", ReplayGainOff},
+        {"Track", ReplayGainTrack},
+        {"Album", ReplayGainAlbum},
+    };
+    const std::vector<ConfigSel_t> selCrossfade = {
+        {"Off", 0},
+        {"1 sec", 1},
+        {"2 sec", 2},
+        {"3 sec", 3},
+        {"5 sec", 5},
+        {"10 sec", 10},
+    };
+    const std::vector<ConfigSel_t> selReadPolicy = {
+        {"Latency First", 0},
+        {"Power First", 1},
+    };
     const std::vector<ConfigSel_t> selButtonLayout = {
         {"Horizontal", 0},
         {"Vetical", 1},
@@ -172,9 +205,13 @@ private:
         {ConfigMenuId::DISPLAY_BACKLIGHT_LOW_LEVEL,   {"Backlight Low Level",   CategoryId_t::DISPLAY, CFG_ID_MENU_IDX_DISPLAY_BACKLIGHT_LOW_LEVEL,   &selBacklightLevel, nullptr}},
         {ConfigMenuId::DISPLAY_BACKLIGHT_HIGH_LEVEL,  {"Backlight High Level",  CategoryId_t::DISPLAY, CFG_ID_MENU_IDX_DISPLAY_BACKLIGHT_HIGH_LEVEL,  &selBacklightLevel, nullptr}},
         {ConfigMenuId::DISPLAY_TIME_TO_BACKLIGHT_LOW, {"Time to Backlight Low", CategoryId_t::DISPLAY, CFG_ID_MENU_IDX_DISPLAY_TIME_TO_BACKLIGHT_LOW, &selTime1,          nullptr}},
+        {ConfigMenuId::DISPLAY_PLAY_SCREEN,           {"Play Screen",           CategoryId_t::DISPLAY, CFG_ID_MENU_IDX_DISPLAY_PLAY_SCREEN,           &selPlayScreen,     hookDispPlayScreen}},
         {ConfigMenuId::PLAY_TIME_TO_NEXT_PLAY,        {"Time to Next Play",     CategoryId_t::PLAY,    CFG_ID_MENU_IDX_PLAY_TIME_TO_NEXT_PLAY,        &selTime2,          nullptr}},
         {ConfigMenuId::PLAY_NEXT_PLAY_ALBUM,          {"Next Play Album",       CategoryId_t::PLAY,    CFG_ID_MENU_IDX_PLAY_NEXT_PLAY_ALBUM,          &selNextPlayAlbum,  nullptr}},
         {ConfigMenuId::PLAY_RANDOM_DIR_DEPTH,         {"Random Dir Depth",      CategoryId_t::PLAY,    CFG_ID_MENU_IDX_PLAY_RANDOM_DIR_DEPTH,         &selRandDirDepth,   nullptr}},
+        {ConfigMenuId::PLAY_REPLAY_GAIN,              {"ReplayGain",            CategoryId_t::PLAY,    CFG_ID_MENU_IDX_PLAY_REPLAY_GAIN,              &selReplayGain,     nullptr}},
+        {ConfigMenuId::PLAY_CROSSFADE,                {"Crossfade",             CategoryId_t::PLAY,    CFG_ID_MENU_IDX_PLAY_CROSSFADE,                &selCrossfade,      nullptr}},
+        {ConfigMenuId::PLAY_READ_POLICY,              {"Read Policy",           CategoryId_t::PLAY,    CFG_ID_MENU_IDX_PLAY_READ_POLICY,              &selReadPolicy,     hookPlayReadPolicy}},
     };
 
     std::map<const CategoryId_t, std::map<const ConfigMenuId, const Item_t*>> menuMapByCategory;
@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include <cstdio>
+#include <string>
+
 #include "FlashParam.h"
 
 typedef enum {
@@ -43,6 +46,10 @@ typedef enum {
     CFG_ID_MENU_IDX_PLAY_TIME_TO_NEXT_PLAY,
     CFG_ID_MENU_IDX_PLAY_NEXT_PLAY_ALBUM,
     CFG_ID_MENU_IDX_PLAY_RANDOM_DIR_DEPTH,
+    CFG_ID_MENU_IDX_PLAY_REPLAY_GAIN,
+    CFG_ID_MENU_IDX_DISPLAY_PLAY_SCREEN,
+    CFG_ID_MENU_IDX_PLAY_CROSSFADE,
+    CFG_ID_MENU_IDX_PLAY_READ_POLICY,
 } ParamId_t;
 
 //=================================
@@ -54,24 +61,24 @@ struct ConfigParam : FlashParamNs::FlashParam {
         return instance;
     }
     // Parameter<T>                      inst                                         id                                             name                                          default  size
-    FlashParamNs::Parameter<std::string> P_CFG_VERSION                               {CFG_ID_VERSION,                                "CFG_VERSION",                                "0.0.0", 16};
+    FlashParamNs::Parameter<std::string> P_CFG_VERSION                               {CFG_ID_VERSION,                                "CFG_VERSION",                                "1.0.0", 16};  // bump when type or order of parameters changes
     FlashParamNs::Parameter<uint32_t>    P_CFG_SEED                                  {CFG_ID_SEED,                                   "CFG_SEED",                                   0};
     FlashParamNs::Parameter<uint8_t>     P_CFG_VOLUME                                {CFG_ID_VOLUME,                                 "CFG_VOLUME",                                 65};
     FlashParamNs::Parameter<uint8_t>     P_CFG_STACK_COUNT                           {CFG_ID_STACK_COUNT,                            "CFG_STACK_COUNT",                            0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_STACK_HEAD0                           {CFG_ID_STACK_HEAD0,                            "CFG_STACK_HEAD0",                            0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_STACK_COLUMN0                         {CFG_ID_STACK_COLUMN0,                          "CFG_STACK_COLUMN0",                          0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_STACK_HEAD1                           {CFG_ID_STACK_HEAD1,                            "CFG_STACK_HEAD1",                            0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_STACK_COLUMN1                         {CFG_ID_STACK_COLUMN1,                          "CFG_STACK_COLUMN1",                          0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_STACK_HEAD2                           {CFG_ID_STACK_HEAD2,                            "CFG_STACK_HEAD2",                            0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_STACK_COLUMN2                         {CFG_ID_STACK_COLUMN2,                          "CFG_STACK_COLUMN2",                          0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_STACK_HEAD3                           {CFG_ID_STACK_HEAD3,                            "CFG_STACK_HEAD3",                            0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_STACK_COLUMN3                         {CFG_ID_STACK_COLUMN3,                          "CFG_STACK_COLUMN3",                          0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_STACK_HEAD4                           {CFG_ID_STACK_HEAD4,                            "CFG_STACK_HEAD4",                            0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_STACK_COLUMN4                         {CFG_ID_STACK_COLUMN4,                          "CFG_STACK_COLUMN4",                          0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_STACK_HEAD0                           {CFG_ID_STACK_HEAD0,                            "CFG_STACK_HEAD0",                            0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_STACK_COLUMN0                         {CFG_ID_STACK_COLUMN0,                          "CFG_STACK_COLUMN0",                          0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_STACK_HEAD1                           {CFG_ID_STACK_HEAD1,                            "CFG_STACK_HEAD1",                            0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_STACK_COLUMN1                         {CFG_ID_STACK_COLUMN1,                          "CFG_STACK_COLUMN1",                          0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_STACK_HEAD2                           {CFG_ID_STACK_HEAD2,                            "CFG_STACK_HEAD2",                            0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_STACK_COLUMN2                         {CFG_ID_STACK_COLUMN2,                          "CFG_STACK_COLUMN2",                          0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_STACK_HEAD3                           {CFG_ID_STACK_HEAD3,                            "CFG_STACK_HEAD3",                            0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_STACK_COLUMN3                         {CFG_ID_STACK_COLUMN3,                          "CFG_STACK_COLUMN3",                          0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_STACK_HEAD4                           {CFG_ID_STACK_HEAD4,                            "CFG_STACK_HEAD4",                            0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_STACK_COLUMN4                         {CFG_ID_STACK_COLUMN4,                          "CFG_STACK_COLUMN4",                          0};
     FlashParamNs::Parameter<uint32_t>    P_CFG_UIMODE                                {CFG_ID_UIMODE,                                 "CFG_UIMODE",                                 0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_IDX_HEAD                              {CFG_ID_IDX_HEAD,                               "CFG_IDX_HEAD",                               0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_IDX_COLUMN                            {CFG_ID_IDX_COLUMN,                             "CFG_IDX_COLUMN",                             0};
-    FlashParamNs::Parameter<uint16_t>    P_CFG_IDX_PLAY                              {CFG_ID_IDX_PLAY,                               "CFG_IDX_PLAY",                               0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_IDX_HEAD                              {CFG_ID_IDX_HEAD,                               "CFG_IDX_HEAD",                               0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_IDX_COLUMN                            {CFG_ID_IDX_COLUMN,                             "CFG_IDX_COLUMN",                             0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_IDX_PLAY                              {CFG_ID_IDX_PLAY,                               "CFG_IDX_PLAY",                               0};
     FlashParamNs::Parameter<uint64_t>    P_CFG_PLAY_POS                              {CFG_ID_PLAY_POS,                               "CFG_PLAY_POS",                               0};
     FlashParamNs::Parameter<uint32_t>    P_CFG_SAMPLES_PLAYED                        {CFG_ID_SAMPLES_PLAYED,                         "CFG_SAMPLES_PLAYED",                         0};
     // type of CFG_MENU_xxx must be uint32_t and default values indidicates index of selection (see ConfigMenu.h)
@@ -87,9 +94,58 @@ struct ConfigParam : FlashParamNs::FlashParam {
     FlashParamNs::Parameter<uint32_t>    P_CFG_MENU_IDX_PLAY_TIME_TO_NEXT_PLAY       {CFG_ID_MENU_IDX_PLAY_TIME_TO_NEXT_PLAY,        "CFG_MENU_IDX_PLAY_TIME_TO_NEXT_PLAY",        2};
     FlashParamNs::Parameter<uint32_t>    P_CFG_MENU_IDX_PLAY_NEXT_PLAY_ALBUM         {CFG_ID_MENU_IDX_PLAY_NEXT_PLAY_ALBUM,          "CFG_MENU_IDX_PLAY_NEXT_PLAY_ALBUM",          1};
     FlashParamNs::Parameter<uint32_t>    P_CFG_MENU_IDX_PLAY_RANDOM_DIR_DEPTH        {CFG_ID_MENU_IDX_PLAY_RANDOM_DIR_DEPTH,         "CFG_MENU_IDX_PLAY_RANDOM_DIR_DEPTH",         1};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_MENU_IDX_PLAY_REPLAY_GAIN             {CFG_ID_MENU_IDX_PLAY_REPLAY_GAIN,              "CFG_MENU_IDX_PLAY_REPLAY_GAIN",              0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_MENU_IDX_DISPLAY_PLAY_SCREEN          {CFG_ID_MENU_IDX_DISPLAY_PLAY_SCREEN,           "CFG_MENU_IDX_DISPLAY_PLAY_SCREEN",           0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_MENU_IDX_PLAY_CROSSFADE               {CFG_ID_MENU_IDX_PLAY_CROSSFADE,                "CFG_MENU_IDX_PLAY_CROSSFADE",                0};
+    FlashParamNs::Parameter<uint32_t>    P_CFG_MENU_IDX_PLAY_READ_POLICY             {CFG_ID_MENU_IDX_PLAY_READ_POLICY,              "CFG_MENU_IDX_PLAY_READ_POLICY",              0};
 
     void initialize(bool preserveStoreCount = false) override {
         FlashParamNs::FlashParam::initialize();
+        std::string stored = P_CFG_VERSION.get();
         P_CFG_VERSION.loadDefault();
+        if (stored != P_CFG_VERSION.get()) {
+            // stored by other layout (e.g. uint16_t STACK_HEADn before 1.0.0), then values are not reliable
+            printf("CFG_VERSION %s -> %s: parameters are initialized\r\n", stored.c_str(), P_CFG_VERSION.get().c_str());
+            loadDefaultAll();
+        }
+    }
+
+private:
+    void loadDefaultAll() {
+        P_CFG_SEED.loadDefault();
+        P_CFG_VOLUME.loadDefault();
+        P_CFG_STACK_COUNT.loadDefault();
+        P_CFG_STACK_HEAD0.loadDefault();
+        P_CFG_STACK_COLUMN0.loadDefault();
+        P_CFG_STACK_HEAD1.loadDefault();
+        P_CFG_STACK_COLUMN1.loadDefault();
+        P_CFG_STACK_HEAD2.loadDefault();
+        P_CFG_STACK_COLUMN2.loadDefault();
+        P_CFG_STACK_HEAD3.loadDefault();
+        P_CFG_STACK_COLUMN3.loadDefault();
+        P_CFG_STACK_HEAD4.loadDefault();
+        P_CFG_STACK_COLUMN4.loadDefault();
+        P_CFG_UIMODE.loadDefault();
+        P_CFG_IDX_HEAD.loadDefault();
+        P_CFG_IDX_COLUMN.loadDefault();
+        P_CFG_IDX_PLAY.loadDefault();
+        P_CFG_PLAY_POS.loadDefault();
+        P_CFG_SAMPLES_PLAYED.loadDefault();
+        P_CFG_MENU_IDX_GENERAL_TIME_TO_POWER_OFF.loadDefault();
+        P_CFG_MENU_IDX_GENERAL_TIME_TO_LEAVE_CONFIG.loadDefault();
+        P_CFG_MENU_IDX_GENERAL_PUSH_BUTTON_LAYOUT.loadDefault();
+        P_CFG_MENU_IDX_GENERAL_HP_BUTTON_LAYOUT.loadDefault();
+        P_CFG_MENU_IDX_DISPLAY_LCD_CONFIG.loadDefault();
+        P_CFG_MENU_IDX_DISPLAY_ROTATION.loadDefault();
+        P_CFG_MENU_IDX_DISPLAY_BACKLIGHT_LOW_LEVEL.loadDefault();
+        P_CFG_MENU_IDX_DISPLAY_BACKLIGHT_HIGH_LEVEL.loadDefault();
+        P_CFG_MENU_IDX_DISPLAY_TIME_TO_BACKLIGHT_LOW.loadDefault();
+        P_CFG_MENU_IDX_PLAY_TIME_TO_NEXT_PLAY.loadDefault();
+        P_CFG_MENU_IDX_PLAY_NEXT_PLAY_ALBUM.loadDefault();
+        P_CFG_MENU_IDX_PLAY_RANDOM_DIR_DEPTH.loadDefault();
+        P_CFG_MENU_IDX_PLAY_REPLAY_GAIN.loadDefault();
+        P_CFG_MENU_IDX_DISPLAY_PLAY_SCREEN.loadDefault();
+        P_CFG_MENU_IDX_PLAY_CROSSFADE.loadDefault();
+        P_CFG_MENU_IDX_PLAY_READ_POLICY.loadDefault();
     }
 };
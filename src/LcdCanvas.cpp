@@ -189,9 +189,7 @@ void LcdCanvas::switchToPlay()
     for (int i = 0; i < (int) (sizeof(groupPlay)/sizeof(*groupPlay)); i++) {
         groupPlay[i]->update();
     }
-    for (int i = 0; i < (int) (sizeof(groupPlay0)/sizeof(*groupPlay0)); i++) {
-        groupPlay0[i]->update();
-    }
+    updatePlay0();
     for (int i = 0; i < (int) (sizeof(groupPlay1)/sizeof(*groupPlay1)); i++) {
         groupPlay1[i]->update();
     }
@@ -236,9 +234,7 @@ void LcdCanvas::drawPlay()
         groupPlay[i]->draw();
     }
     if (play_count % play_cycle < play_change || !image.hasImage()) { // Play mode 0 display
-        for (int i = 0; i < (int) (sizeof(groupPlay0)/sizeof(*groupPlay0)); i++) {
-            groupPlay0[i]->draw();
-        }
+        drawPlay0();
         if (play_count % play_cycle == play_change-1 && image.hasImage()) { // Play mode 0 -> 1
             clear(false);
             for (int i = 0; i < (int) (sizeof(groupPlay)/sizeof(*groupPlay)); i++) {
@@ -257,14 +253,38 @@ void LcdCanvas::drawPlay()
             for (int i = 0; i < (int) (sizeof(groupPlay)/sizeof(*groupPlay)); i++) {
                 groupPlay[i]->update();
             }
-            for (int i = 0; i < (int) (sizeof(groupPlay0)/sizeof(*groupPlay0)); i++) {
-                groupPlay0[i]->update();
-            }
+            updatePlay0();
         }
     }
     play_count++;
 }
 
+void LcdCanvas::updatePlay0()
+{
+    if (playScreen == PlayScreenSpectrum) {
+        for (int i = 0; i < (int) (sizeof(groupPlay2)/sizeof(*groupPlay2)); i++) {
+            groupPlay2[i]->update();
+        }
+    } else {
+        for (int i = 0; i < (int) (sizeof(groupPlay0)/sizeof(*groupPlay0)); i++) {
+            groupPlay0[i]->update();
+        }
+    }
+}
+
+void LcdCanvas::drawPlay0()
+{
+    if (playScreen == PlayScreenSpectrum) {
+        for (int i = 0; i < (int) (sizeof(groupPlay2)/sizeof(*groupPlay2)); i++) {
+            groupPlay2[i]->draw();
+        }
+    } else {
+        for (int i = 0; i < (int) (sizeof(groupPlay0)/sizeof(*groupPlay0)); i++) {
+            groupPlay0[i]->draw();
+        }
+    }
+}
+
 void LcdCanvas::drawPowerOff()
 {
     for (int i = 0; i < (int) (sizeof(groupPowerOff)/sizeof(*groupPowerOff)); i++) {
@@ -315,6 +335,22 @@ void LcdCanvas::setAudioLevel(float levelL, float levelR)
     levelMeterR.setLevel(levelR);
 }
 
+void LcdCanvas::setAudioPeak(float peakL, float peakR)
+{
+    levelMeterL.setMarker(peakL);
+    levelMeterR.setMarker(peakR);
+}
+
+void LcdCanvas::setPlayScreen(uint8_t value)
+{
+    playScreen = (value == PlayScreenSpectrum) ? PlayScreenSpectrum : PlayScreenLevelMeter;
+}
+
+void LcdCanvas::setSpectrum(const float* levels, int numBands)
+{
+    spectrum.setLevels(levels, numBands);
+}
+
 void LcdCanvas::setBitRes(uint16_t value)
 {
     // compose Icon for bit resolution part (upper half)
@@ -54,6 +54,9 @@ public:
     void setListItem(int column, const char* str, const IconIndex_t index = IconIndex_t::UNDEF, bool isFocused = false);
     void setVolume(uint8_t value);
     void setAudioLevel(float levelL, float levelR);
+    void setAudioPeak(float peakL, float peakR);
+    void setPlayScreen(uint8_t value);
+    void setSpectrum(const float* levels, int numBands);
     void setBitRes(uint16_t value);
     void setSampleFreq(uint32_t sampFreq);
     void setPlayTime(uint32_t posionSec, uint32_t lengthSec, bool blink = false);
@@ -72,9 +75,15 @@ public:
     void drawPlay();
     void drawPowerOff();
     uint16_t getTiledImage(uint16_t x, uint16_t y);
+    static constexpr int NumSpectrumBands = 16;
 
 protected:
+    typedef enum {
+        PlayScreenLevelMeter = 0,
+        PlayScreenSpectrum
+    } PlayScreen_t;
     int play_count;
+    uint8_t playScreen = PlayScreenLevelMeter;
     const int play_cycle = 400;
     const int play_change = 350;
     uint8_t bitSampIcon[32] = {};
@@ -96,6 +105,7 @@ protected:
     HorizontalBarBox levelMeterL = HorizontalBarBox(16*0, 16*3, LCD_W()-16, 4, LCD_DARKGRAY);
     HorizontalBarBox levelMeterR = HorizontalBarBox(16*0, 16*3+8, LCD_W()-16, 4, LCD_DARKGRAY);
     IconBox bitSamp = IconBox(LCD_W()-16, 16*3, ICON2PTR(IconIndex_t::UNDEF), LCD_GRAY);
+    SpectrumBox spectrum = SpectrumBox(16*0, 16*0, LCD_W(), 16*4-1, NumSpectrumBands, LCD_GRAYBLUE);
     HorizontalBarBox timeProgress = HorizontalBarBox(16*0, 16*4-1, LCD_W(), 1, LCD_BLUE, LCD_DARKGRAY, true);
     TextBox track = TextBox(16*0, LCD_H()-16*1, LcdElementBox::AlignLeft, LCD_GRAY);
     TextBox msg = TextBox(LCD_W()/2, LCD_H()/2-FONT_HEIGHT/2, LcdElementBox::AlignCenter, LCD_WHITE, LCD_BLACK, true);
@@ -106,6 +116,7 @@ protected:
     LcdElementBox* groupPlay[1] = {&battery}; // Common for Play mode 0 and 1
     LcdElementBox* groupPlay0[10] = {&title, &artist, &album, &levelMeterL, &levelMeterR, &bitSamp, &timeProgress, &track, &playTime, &volume}; // Play mode 0 only
     LcdElementBox* groupPlay1[2] = {&image, &msg}; // Play mode 1 only
+    LcdElementBox* groupPlay2[5] = {&spectrum, &timeProgress, &track, &playTime, &volume}; // Play mode 0 only (Spectrum screen)
     LcdElementBox* groupPowerOff[1] = {&msg};
 
     // Singleton
@@ -113,6 +124,8 @@ protected:
     virtual ~LcdCanvas() = default;
     LcdCanvas(const LcdCanvas&) = delete;
     LcdCanvas& operator=(const LcdCanvas&) = delete;
+    void updatePlay0();
+    void drawPlay0();
 #endif // USE_ST7735S_160x80
 };
 
@@ -11,9 +11,12 @@
 
 #include "TagRead.h"
 
+#include <cstdlib>
 #include <cstring>
+#include <strings.h>
 #include <tuple>
 
+#include "io_service.h"
 #include "utf_conv.h"
 
 TagRead::TagRead()
@@ -70,7 +73,7 @@ size_t TagRead::getBESize4SyncSafe(const uint8_t* buf)
 
 FRESULT TagRead::f_read_unsync(FIL* fp, void* buff, UINT btr, UINT* br, bool unsync)
 {
-    return f_read(fp, buff, btr, br);
+    return io_f_read(IO_REQ_META, fp, buff, btr, br);
 }
 
 int TagRead::loadFile(const char* filename)
@@ -80,7 +83,7 @@ int TagRead::loadFile(const char* filename)
     clearMP4_ilst();
 
     FRESULT fr;
-	fr = f_open(&fil, (TCHAR*) filename, FA_READ);
+	fr = io_f_open(IO_REQ_META, &fil, (TCHAR*) filename, FA_READ);
     if (fr != FR_OK) {
         return 1;
     }
@@ -90,7 +93,7 @@ int TagRead::loadFile(const char* filename)
 
     // try ID3v1 or ID3v2
     if (GetID3HeadersFull(fil, 1 /* 1: no-debug display, 0: debug display */, id3v1, id3v2) == 0) {
-        f_close(&fil);
+        io_f_close(IO_REQ_META, &fil);
         return 1;
     }
 
@@ -100,18 +103,18 @@ int TagRead::loadFile(const char* filename)
 
     // try ID3v2 in WAV chunk format
     if (GetID3v2FromRiffChunk(fil, chunk_list, id3v2)) {
-        f_close(&fil);
+        io_f_close(IO_REQ_META, &fil);
         return 1;
     }
 
     // If all failed, try to read LIST chunk
     if (GetListFromRiffChunk(fil, chunk_list, id3v1)) {
-        f_close(&fil);
+        io_f_close(IO_REQ_META, &fil);
         return 1;
     }
 
     // No available tags found
-    f_close(&fil);
+    io_f_close(IO_REQ_META, &fil);
     return 0;
 }
 
@@ -130,7 +133,7 @@ int TagRead::GetID3HeadersFull(FIL& infile, int testfail, id31*& id31save, id32*
     // For ID3(v1)
     //=============
     // seek to start of header
-    f_lseek(&infile, f_size(&infile) - sizeof(id31));
+    io_f_lseek(IO_REQ_META, &infile, f_size(&infile) - sizeof(id31));
     /*
     if (result) {
         printf("Error seeking to header\n");
@@ -140,7 +143,7 @@ int TagRead::GetID3HeadersFull(FIL& infile, int testfail, id31*& id31save, id32*
   
     // read in to buffer
     input = (char*) malloc(sizeof(id31));
-    fr = f_read(&infile, input, sizeof(id31), &br);
+    fr = io_f_read(IO_REQ_META, &infile, input, sizeof(id31), &br);
     result = br;
     if (result != sizeof(id31)) {
         printf("Read fail: expected %d bytes but got %d\n", sizeof(id31), result);
@@ -202,11 +205,11 @@ id32* TagRead::ID32Detect(FIL* infile, const size_t pos)
     UINT br;
 
     // seek to start
-    f_lseek(infile, filepos);
+    io_f_lseek(IO_REQ_META, infile, filepos);
     // read in first 10 bytes
     buffer = (uint8_t*) calloc(1, 11);
     id32header = (id32*) calloc(1, sizeof(id32));
-    fr = f_read(infile, buffer, 10, &br);
+    fr = io_f_read(IO_REQ_META, infile, buffer, 10, &br);
     result = br;
 
     //filepos += result;
@@ -307,7 +310,7 @@ id32* TagRead::ID32Detect(FIL* infile, const size_t pos)
                 */
                 frame->data = (char*) calloc(1, frame_start_bytes); // for frame parsing
                 f_read_unsync(infile, frame->data, frame_start_bytes, &br, unsync);
-                if (f_lseek(infile, frame->pos + frame->size) == FR_OK) {
+                if (io_f_lseek(IO_REQ_META, infile, frame->pos + frame->size) == FR_OK) {
                     result = frame->size;
                 } else {
                     result = 0;
@@ -394,7 +397,7 @@ id32* TagRead::ID32Detect(FIL* infile, const size_t pos)
                 */
                 frame->data = (char*) calloc(1, frame_start_bytes); // for frame parsing
                 f_read_unsync(infile, frame->data, frame_start_bytes, &br, unsync);
-                if (f_lseek(infile, frame->pos + frame->size) == FR_OK) {
+                if (io_f_lseek(IO_REQ_META, infile, frame->pos + frame->size) == FR_OK) {
                     result = frame->size;
                 } else {
                     result = 0;
@@ -482,7 +485,7 @@ id32* TagRead::ID32Detect(FIL* infile, const size_t pos)
                 frame->data = (char*) calloc(1, frame_start_bytes); // for frame parsing
                 fr = f_read_unsync(infile, frame->data, frame_start_bytes, &br, unsync);
                 result = br;
-                if (f_lseek(infile, frame->pos + frame->size) == FR_OK) {
+                if (io_f_lseek(IO_REQ_META, infile, frame->pos + frame->size) == FR_OK) {
                     result = frame->size;
                 } else {
                     result = 0;
@@ -570,6 +573,20 @@ int TagRead::getUTF8Year(char* str, size_t size)
     return 0;
 }
 
+int TagRead::getReplayGain(bool album, float& gainDb)
+{
+    // ReplayGain 2.0 / EBU R128 results stored by host tools (rsgain, foobar2000 etc.) as ID3v2 user text frames
+    // value format: "-6.54 dB"
+    char str[32];
+    const char* desc = album ? "REPLAYGAIN_ALBUM_GAIN" : "REPLAYGAIN_TRACK_GAIN";
+    if (!GetID32UserText(desc, str, sizeof(str))) {
+        if (!album || !GetID32UserText("REPLAYGAIN_TRACK_GAIN", str, sizeof(str))) { return 0; }  // fallback to track gain
+    }
+    char* end;
+    gainDb = strtof(str, &end);
+    return (end != str);
+}
+
 int TagRead::getPictureCount()
 {
     return GetMP4TypeCount("covr") + GetID3IDCount("PIC", "APIC");
@@ -848,6 +865,77 @@ int TagRead::GetID3IDCount(const char* id3v22, const char* id3v23)
     return count;
 }
 
+int TagRead::GetID32UserText(const char* desc, char* str, size_t size)
+{
+    if (!id3v2) { return 0; }
+    id32frame* thisframe;
+    int ver = id3v2->version[0];
+    // loop through tags and process
+    thisframe = id3v2->firstframe;
+    while (thisframe != NULL) {
+        const char* data;
+        size_t frame_size;
+        if (ver == 2) { // ID3v2.2
+            id322frame* tframe = (id322frame*) thisframe;
+            data = (!strncmp("TXX", tframe->ID, 3) && tframe->hasFullData) ? tframe->data : nullptr;
+            frame_size = tframe->size;
+        } else { // ID3v2.3, ID3v2.4
+            data = (!strncmp("TXXX", thisframe->ID, 4) && thisframe->hasFullData) ? thisframe->data : nullptr;
+            frame_size = thisframe->size;
+        }
+        // encoding(1) + description(\0 terminated) + value (no '\0' termination)
+        if (data != nullptr && frame_size > 1) {
+            std::string frame_desc;
+            std::string frame_value;
+            switch (data[0]) {
+                case 0: // ISO-8859-1
+                case 3: { // UTF-8 (ID3v2.4 or later only)
+                    size_t len = strnlen(&data[1], frame_size - 1);
+                    frame_desc.assign(&data[1], len);
+                    if (1 + len + 1 < frame_size) {
+                        frame_value.assign(&data[1 + len + 1], strnlen(&data[1 + len + 1], frame_size - (1 + len + 1)));
+                    }
+                    break;
+                }
+                case 1: // UTF-16 (w/ BOM)
+                case 2: { // UTF-16 (w/o BOM) (ID3v2.4 or later only)
+                    std::u16string u16[2];
+                    size_t ofs = 1;
+                    for (int k = 0; k < 2; k++) {
+                        bool big_endian = (data[0] == 2);  // UTF-16BE unless BOM tells
+                        if (data[0] == 1 && ofs + 1 < frame_size) {
+                            uint16_t bom = static_cast<uint8_t>(data[ofs]) << 8 | static_cast<uint8_t>(data[ofs+1]);
+                            if (bom == 0xFFFE) { big_endian = false; ofs += 2; }
+                            else if (bom == 0xFEFF) { big_endian = true; ofs += 2; }
+                        }
+                        while (ofs + 1 < frame_size) {
+                            uint8_t b0 = static_cast<uint8_t>(data[ofs]);
+                            uint8_t b1 = static_cast<uint8_t>(data[ofs+1]);
+                            char16_t c = big_endian ? static_cast<char16_t>(b0 << 8 | b1) : static_cast<char16_t>(b1 << 8 | b0);
+                            ofs += 2;
+                            if (c == 0) { break; }
+                            u16[k].push_back(c);
+                        }
+                    }
+                    frame_desc = utf16_to_utf8(u16[0]);
+                    frame_value = utf16_to_utf8(u16[1]);
+                    break;
+                }
+                default:
+                    break;
+            }
+            if (strcasecmp(frame_desc.c_str(), desc) == 0) {
+                size_t max_size = (frame_value.length() <= size - 1) ? frame_value.length() : size - 1;
+                memcpy(str, frame_value.c_str(), max_size);
+                str[max_size] = '\0';
+                return 1;
+            }
+        }
+        thisframe = (ver == 2) ? (id32frame*) ((id322frame*) thisframe)->next : thisframe->next;
+    }
+    return 0;
+}
+
 void TagRead::ID32Print(id32* id32header)
 {
     id32frame* thisframe;
@@ -1067,8 +1155,8 @@ int TagRead::findNextMP4Box(FIL* file, size_t end_pos, char type[4], size_t* pos
     FRESULT fr;
     UINT br;
     if (end_pos <= *pos + 8) { return 0; }
-    f_lseek(file, *pos);
-    f_read(file, c, sizeof(c), &br);
+    io_f_lseek(IO_REQ_META, file, *pos);
+    io_f_read(IO_REQ_META, file, c, sizeof(c), &br);
     *size = getBESize4(c);
     memcpy(type, &c[4], 4);
     if (*size < 8) { return 0; } // size is out of 32bit range
@@ -1106,14 +1194,14 @@ int TagRead::findNextMP4Box(FIL* file, size_t end_pos, char type[4], size_t* pos
         }
         */
         uint8_t data[8];
-        f_lseek(file, *pos - *size + 8);
-        f_read(file, data, sizeof(data), &br);
+        io_f_lseek(IO_REQ_META, file, *pos - *size + 8);
+        io_f_read(IO_REQ_META, file, data, sizeof(data), &br);
         uint32_t data_size = getBESize4(data) - 8 - 8; // - 8 - 8: - (size(4) + 'data'(4)) - (data_type(4) + data_locale(4))
         if (data[4] == 'd' && data[5] == 'a' && data[6] == 't' && data[7] == 'a') {
             uint8_t data_type[4];
             uint8_t data_locale[4];
-            f_read(file, data_type, sizeof(data_type), &br);
-            f_read(file, data_locale, sizeof(data_locale), &br);
+            io_f_read(IO_REQ_META, file, data_type, sizeof(data_type), &br);
+            io_f_read(IO_REQ_META, file, data_locale, sizeof(data_locale), &br);
             MP4_ilst_item* mp4_ilst_item = (MP4_ilst_item*) calloc(1, sizeof(MP4_ilst_item));
             if (mp4_ilst.first == NULL) {
                 mp4_ilst.first = mp4_ilst.last = mp4_ilst_item;
@@ -1129,12 +1217,12 @@ int TagRead::findNextMP4Box(FIL* file, size_t end_pos, char type[4], size_t* pos
             if (data_size < frame_size_limit) {
                 mp4_ilst.last->hasFullData = true;
                 mp4_ilst.last->data_buf = (char*) calloc(1, data_size);
-                f_read(file, mp4_ilst.last->data_buf, data_size, &br);
+                io_f_read(IO_REQ_META, file, mp4_ilst.last->data_buf, data_size, &br);
             } else {
                 mp4_ilst.last->hasFullData = false;
                 mp4_ilst.last->data_buf = (char*) calloc(1, frame_start_bytes);
-                f_read(file, mp4_ilst.last->data_buf, frame_start_bytes, &br);
-                f_lseek(file, mp4_ilst.last->pos + data_size);
+                io_f_read(IO_REQ_META, file, mp4_ilst.last->data_buf, frame_start_bytes, &br);
+                io_f_lseek(IO_REQ_META, file, mp4_ilst.last->pos + data_size);
             }
             mp4_ilst.last->next = NULL;
         }
@@ -1232,8 +1320,8 @@ T TagRead::read(FIL& file, const size_t pos, const size_t size)
     T s;
     UINT br;
     std::vector<uint8_t> v(size, 0);
-    f_lseek(&file, pos);
-    f_read(&file, v.data(), v.size(), &br);
+    io_f_lseek(IO_REQ_META, &file, pos);
+    io_f_read(IO_REQ_META, &file, v.data(), v.size(), &br);
     std::copy(v.begin(), v.end(), std::back_inserter(s));
     return s;
 }
\ No newline at end of file
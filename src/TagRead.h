@@ -149,6 +149,7 @@ public:
     int getUTF8Album(char* str, size_t size);
     int getUTF8Artist(char* str, size_t size);
     int getUTF8Year(char* str, size_t size);
+    int getReplayGain(bool album, float& gainDb);
     int getPictureCount();
     int getPicturePos(int idx, mime_t& mime, ptype_t& ptype, size_t& pos, size_t& size, bool& isUnsynced);
 
@@ -171,6 +172,7 @@ private:
     id32* ID32Detect(FIL* infile, const size_t pos = 0);
     int GetID32UTF8(const char* id3v22, const char* id3v23, char* str, size_t size);
     int GetID3IDCount(const char* id3v22, const char* id3v23);
+    int GetID32UserText(const char* desc, char* str, size_t size);
     void ID32Print(id32* id32header);
     void ID32Free(id32* id32header);
     int getID32Picture(int idx, mime_t& mime, ptype_t& ptype, size_t& pos, size_t& size, bool& isUnsynced);
@@ -16,6 +16,7 @@
 #include "audio_codec.h"
 #include "file_menu_FatFs.h"
 #include "power_manage.h"
+#include "SpectrumAnalyzer.h"
 #include "TagRead.h"
 #include "tf_card.h"
 
@@ -52,6 +53,9 @@ void UIMode::initialize(UIVars* vars)
     ui_mode_ary[ConfigMode]   = (UIMode*) new UIConfigMode();
     ui_mode_ary[PowerOffMode] = (UIMode*) new UIPowerOffMode();
     lcd = &LcdCanvas::instance();
+    file_menu_set_ext_type("wav", FILE_MENU_TYPE_AUDIO);
+    file_menu_set_ext_type("jpg", FILE_MENU_TYPE_IMAGE);
+    file_menu_set_ext_type("jpeg", FILE_MENU_TYPE_IMAGE);
 }
 
 UIMode* UIMode::getUIMode(const ui_mode_enm_t& ui_mode_enm)
@@ -74,9 +78,9 @@ void UIMode::entry(UIMode* prevMode)
     ui_clear_btn_evt();
 }
 
-bool UIMode::isAudioFile(const uint16_t& idx) const
+bool UIMode::isAudioFile(const uint32_t& idx) const
 {
-    if (file_menu_match_ext(idx, "wav", 3) ||  file_menu_match_ext(idx, "WAV", 3)) {
+    if (file_menu_is_type(idx, FILE_MENU_TYPE_AUDIO)) {
         set_audio_codec(PlayAudio::AUDIO_CODEC_WAV);
         return true;
     }
@@ -207,7 +211,6 @@ void UIOpeningMode::restoreFromFlash() const
         item.head = head_param.get();
         item.column = column_param.get();
         if (item.head+item.column >= file_menu_get_num()) { err_flg = true; break; } // idx overflow
-        file_menu_sort_entry(item.head+item.column, item.head+item.column + 1);
         if (file_menu_is_dir(item.head+item.column) <= 0 || item.head+item.column == 0) { err_flg = true; break; } // Not Directory or Parent Directory
         dir_stack.push(item);
         file_menu_ch_dir(item.head+item.column);
@@ -215,8 +218,8 @@ void UIOpeningMode::restoreFromFlash() const
 
     vars->init_dest_ui_mode = static_cast<ui_mode_enm_t>(cfgParam.P_CFG_UIMODE.get());
 
-    uint16_t idx_head = cfgParam.P_CFG_IDX_HEAD.get();
-    uint16_t idx_column = cfgParam.P_CFG_IDX_COLUMN.get();
+    uint32_t idx_head = cfgParam.P_CFG_IDX_HEAD.get();
+    uint32_t idx_column = cfgParam.P_CFG_IDX_COLUMN.get();
     if (idx_head+idx_column >= file_menu_get_num()) { err_flg = true; } // idx overflow
     if (err_flg) { // Load Error
         printf("dir_stack Load Error. root directory is set\r\n");
@@ -319,6 +322,13 @@ void UIFileViewMode::listIdxItems()
 {
     char str[256];
     memset(str, 0, sizeof(str));
+    listPending = !file_menu_is_ready(vars->idx_head + vars->num_list_lines);
+    if (listPending) { // listed by update() when the page is available from core1
+        for (int i = 0; i < vars->num_list_lines; i++) {
+            lcd->setListItem(i, ""); // delete
+        }
+        return;
+    }
     for (int i = 0; i < vars->num_list_lines; i++) {
         if (vars->idx_head+i >= file_menu_get_num()) {
             lcd->setListItem(i, ""); // delete
@@ -330,11 +340,9 @@ void UIFileViewMode::listIdxItems()
     }
 }
 
-uint16_t UIFileViewMode::getNumAudioFiles() const
+uint32_t UIFileViewMode::getNumAudioFiles() const
 {
-    uint16_t num_tracks = 0;
-    num_tracks += file_menu_get_ext_num("wav", 3) + file_menu_get_ext_num("WAV", 3);
-    return num_tracks;
+    return file_menu_get_type_num(FILE_MENU_TYPE_AUDIO);
 }
 
 void UIFileViewMode::chdir() const
@@ -356,7 +364,6 @@ void UIFileViewMode::chdir() const
                     item = temp_stack.top();
                     temp_stack.pop();
                     //printf("pushA %d %d %d\r\n", dir_stack.size(), item.head, item.column);
-                    file_menu_sort_entry(item.head+item.column, item.head+item.column+1);
                     file_menu_ch_dir(item.head+item.column);
                     dir_stack.push(item);
                 }
@@ -415,42 +422,73 @@ UIMode* UIFileViewMode::nextPlay()
 
 UIMode* UIFileViewMode::sequentialSearch(const bool& repeatFlg)
 {
-    int stack_count;
-    uint16_t last_dir_idx;
+    AlbumIndex& albums = AlbumIndex::instance();
+    AlbumIndex::Album_t album;
+    uint32_t orders[AlbumIndex::MaxDepth];
+    uint32_t first, last, cur, idx;
 
     printf("Sequential Search\r\n");
-    stack_count = dir_stack.size();
-    if (stack_count < 1) { return this; }
-    {
-        vars->idx_head = 0;
-        vars->idx_column = 0;
-        chdir(); // cd ..;
+    if (dir_stack.size() < 1) { return this; }
+    if (dir_stack.size() > AlbumIndex::MaxDepth) { return siblingSearch(repeatFlg); } // not in the index
+    // next album among the sibling folders of the current one
+    uint32_t num_orders = getDirOrders(orders);
+    for (int retry = 0; retry < 2; retry++) {
+        if (!albums.prepare()) { break; }
+        bool found = albums.find(orders, num_orders, cur);
+        albums.getRange(orders, num_orders - 1, first, last);
+        bool next = albums.findDepth(found ? cur + 1 : cur, last, num_orders, idx);
+        if (!next) {
+            if (repeatFlg) {
+                // [Option 1] loop back to first album
+                next = albums.findDepth(first, last, num_orders, idx);
+            } else {
+                // [Option 2] stop at the bottom of albums (go back to last dir)
+                if (found && albums.get(cur, album) && openAlbum(album)) { return this; }
+                break;
+            }
+        }
+        if (next && albums.get(idx, album) && openAlbum(album)) {
+            findFirstAudioTrack();
+            return getUIPlayMode();
+        }
+        printf("Retry Sequential Search\r\n");
+        albums.invalidate(); // the card has been changed since the index was checked
     }
+    openRoot();
+    return this;
+}
+
+// Walk the sibling folders one by one for the next album (folders deeper than AlbumIndex::MaxDepth)
+UIMode* UIFileViewMode::siblingSearch(const bool& repeatFlg)
+{
+    size_t stack_count = dir_stack.size();
+    uint32_t last_dir_idx;
+
+    vars->idx_head = 0;
+    vars->idx_column = 0;
+    chdir(); // cd ..;
     vars->idx_head += vars->idx_column;
     vars->idx_column = 0;
     last_dir_idx = vars->idx_head;
     while (1) {
-        {
-            if (file_menu_get_dir_num() == 0) { break; }
-            while (1) {
-                vars->idx_head++;
-                if (repeatFlg) {
-                    // [Option 1] loop back to first album (don't take ".." directory)
-                    if (vars->idx_head >= file_menu_get_num()) { vars->idx_head = 1; }
-                } else {
-                    // [Option 2] stop at the bottom of albums
-                    if (vars->idx_head >= file_menu_get_num()) {
-                        // go back to last dir
-                        vars->idx_head = last_dir_idx;
-                        chdir();
-                        return this;
-                    }
+        if (file_menu_get_dir_num() == 0) { break; }
+        while (1) {
+            vars->idx_head++;
+            if (repeatFlg) {
+                // [Option 1] loop back to first album (don't take ".." directory)
+                if (vars->idx_head >= file_menu_get_num()) { vars->idx_head = 1; }
+            } else {
+                // [Option 2] stop at the bottom of albums
+                if (vars->idx_head >= file_menu_get_num()) {
+                    // go back to last dir
+                    vars->idx_head = last_dir_idx;
+                    chdir();
+                    return this;
                 }
-                file_menu_sort_entry(vars->idx_head, vars->idx_head+1);
-                if (file_menu_is_dir(vars->idx_head) > 0) { break; }
             }
-            chdir();
+            if (file_menu_is_dir(vars->idx_head) > 0) { break; }
         }
+        chdir();
         // Check if Next Target Dir has Audio track files
         if (stack_count == dir_stack.size() && getNumAudioFiles() > 0) {
             findFirstAudioTrack();
@@ -469,42 +507,65 @@ UIMode* UIFileViewMode::sequentialSearch(const bool& repeatFlg)
 
 UIMode* UIFileViewMode::randomSearch(const uint16_t& depth)
 {
-    int i;
-    int stack_count;
+    AlbumIndex& albums = AlbumIndex::instance();
+    AlbumIndex::Album_t album;
+    uint32_t orders[AlbumIndex::MaxDepth];
+    uint32_t first, last, idx;
 
     printf("Random Search\r\n");
-    stack_count = dir_stack.size();
-    if (stack_count < depth) { return this; }
-    for (i = 0; i < depth; i++) {
-        vars->idx_head = 0;
-        vars->idx_column = 0;
-        chdir(); // cd ..;
-    }
-    while (1) {
-        for (i = 0; i < depth; i++) {
-            if (file_menu_get_dir_num() == 0) { break; }
-            while (1) {
-                vars->idx_head = rand() % file_menu_get_num();
-                file_menu_sort_entry(vars->idx_head, vars->idx_head+1);
-                if (file_menu_is_dir(vars->idx_head) > 0) { break; }
-            }
-            vars->idx_column = 0;
-            chdir();
-        }
-        // Check if Next Target Dir has Audio track files
-        if (stack_count == dir_stack.size() && getNumAudioFiles() > 0) {
+    if (dir_stack.size() < depth) { return this; }
+    // pick from the albums in the folder 'depth' levels up
+    uint32_t num_orders = getDirOrders(orders);
+    uint32_t scope_depth = dir_stack.size() - depth;
+    if (scope_depth > num_orders) { scope_depth = num_orders; }
+    for (int retry = 0; retry < 2; retry++) {
+        if (!albums.prepare()) { break; }
+        albums.getRange(orders, scope_depth, first, last);
+        if (albums.shuffle(first, last, idx) && albums.get(idx, album) && openAlbum(album)) {
             findFirstAudioTrack();
-            break;
+            return getUIPlayMode();
         }
-        // Otherwise, chdir to stack_count-depth and retry again
         printf("Retry Random Search\r\n");
-        while (stack_count - depth != dir_stack.size()) {
-            vars->idx_head = 0;
-            vars->idx_column = 0;
-            chdir(); // cd ..;
-        }
+        albums.invalidate(); // the card has been changed since the index was built
     }
-    return getUIPlayMode();
+    openRoot();
+    return this;
+}
+
+uint32_t UIFileViewMode::getDirOrders(uint32_t* orders) const
+{
+    std::stack<stack_data_t> temp_stack = dir_stack;
+    uint32_t num = (temp_stack.size() < AlbumIndex::MaxDepth) ? temp_stack.size() : AlbumIndex::MaxDepth;
+    while (temp_stack.size() > num) { temp_stack.pop(); }
+    for (uint32_t i = num; i > 0; i--) {
+        orders[i-1] = temp_stack.top().head + temp_stack.top().column;
+        temp_stack.pop();
+    }
+    return num;
+}
+
+bool UIFileViewMode::openAlbum(const AlbumIndex::Album_t& album) const
+{
+    while (dir_stack.size() > 0) { dir_stack.pop(); }
+    vars->idx_head = 0;
+    vars->idx_column = 0;
+    if (file_menu_open_dir(album.path) != FR_OK) { return false; }
+    for (uint32_t i = 0; i < album.depth; i++) {
+        stack_data_t item;
+        item.head = album.orders[i];
+        item.column = 0;
+        dir_stack.push(item);
+    }
+    return getNumAudioFiles() > 0;
+}
+
+void UIFileViewMode::openRoot() const
+{
+    while (dir_stack.size() > 0) { dir_stack.pop(); }
+    file_menu_close_dir();
+    file_menu_open_dir("/"); // Root directory
+    vars->idx_head = 0;
+    vars->idx_column = 0;
 }
 
 void UIFileViewMode::findFirstAudioTrack() const
@@ -518,11 +579,11 @@ void UIFileViewMode::findFirstAudioTrack() const
 
 void UIFileViewMode::idxInc() const
 {
-    if (vars->idx_head >= file_menu_get_num() - vars->num_list_lines && vars->idx_column == vars->num_list_lines-1) { return; }
+    if ((int32_t) vars->idx_head >= (int32_t) file_menu_get_num() - vars->num_list_lines && vars->idx_column == vars->num_list_lines-1) { return; }
     if (vars->idx_head + vars->idx_column + 1 >= file_menu_get_num()) { return; }
     vars->idx_column++;
     if (vars->idx_column >= vars->num_list_lines) {
-        if (vars->idx_head + vars->num_list_lines >= file_menu_get_num() - vars->num_list_lines) {
+        if ((int32_t) (vars->idx_head + vars->num_list_lines) >= (int32_t) file_menu_get_num() - vars->num_list_lines) {
             vars->idx_column = vars->num_list_lines-1;
             vars->idx_head++;
         } else {
@@ -550,11 +611,11 @@ void UIFileViewMode::idxDec() const
 
 void UIFileViewMode::idxFastInc() const
 {
-    if (vars->idx_head >= file_menu_get_num() - vars->num_list_lines && vars->idx_column == vars->num_list_lines-1) { return; }
+    if ((int32_t) vars->idx_head >= (int32_t) file_menu_get_num() - vars->num_list_lines && vars->idx_column == vars->num_list_lines-1) { return; }
     if (vars->idx_head + vars->idx_column + 1 >= file_menu_get_num()) { return; }
     if (file_menu_get_num() < vars->num_list_lines) {
         idxInc();
-    } else if (vars->idx_head + vars->num_list_lines >= file_menu_get_num() - vars->num_list_lines) {
+    } else if ((int32_t) (vars->idx_head + vars->num_list_lines) >= (int32_t) file_menu_get_num() - vars->num_list_lines) {
         vars->idx_head = file_menu_get_num() - vars->num_list_lines;
         idxInc();
     } else {
@@ -578,7 +639,6 @@ UIMode* UIFileViewMode::getUIPlayMode()
     if (vars->idx_play == 0) {
         vars->idx_play = vars->idx_head + vars->idx_column;
     }
-    //file_menu_full_sort();
     vars->num_tracks = getNumAudioFiles();
     return getUIMode(PlayMode);
 }
@@ -586,6 +646,8 @@ UIMode* UIFileViewMode::getUIPlayMode()
 UIMode* UIFileViewMode::update()
 {
     vars->resume_ui_mode = ui_mode_enm;
+    if (!file_menu_is_ready(vars->idx_head + vars->num_list_lines)) { return this; } // button events are kept till the page is available
+    if (listPending) { listIdxItems(); }
     switch (vars->init_dest_ui_mode) {
         case PlayMode:
             if (isAudioFile(vars->idx_play)) {
@@ -682,8 +744,6 @@ UIMode* UIFileViewMode::update()
     } else if (idle_count > cfgMenu.get(ConfigMenuId::GENERAL_TIME_TO_POWER_OFF) * OneSec) {
         lcd->setMsg("Bye");
         return getUIMode(PowerOffMode);
-    } else if (idle_count > 5 * OneSec) {
-        file_menu_idle(); // for background sort
     }
     lcd->setBatteryVoltage(pm_get_battery_voltage());
     idle_count++;
@@ -773,12 +833,25 @@ UIMode* UIPlayMode::update()
         codec->stop();
         vars->do_next_play = TimeoutPlay;
         return getUIMode(FileViewMode);
+    } else if (xfadeIdx != 0) {
+        if (!codec->isCrossfading()) { switchToCrossfaded(codec); }
+    } else if (!xfadeTried) {
+        startCrossfade(codec);
     }
     lcd->setVolume(PlayAudio::getVolume());
     lcd->setPlayTime(codec->elapsedMillis()/1000, codec->totalMillis()/1000, codec->isPaused());
     float levelL, levelR;
     codec->getLevel(&levelL, &levelR);
     lcd->setAudioLevel(levelL, levelR);
+    float peakL, peakR;
+    codec->getPeakLevel(&peakL, &peakR);
+    lcd->setAudioPeak(peakL, peakR);
+    if (SpectrumAnalyzer::isEnabled() && !codec->isPaused()) {
+        float bands[LcdCanvas::NumSpectrumBands];
+        if (SpectrumAnalyzer::analyze(bands, LcdCanvas::NumSpectrumBands)) {
+            lcd->setSpectrum(bands, LcdCanvas::NumSpectrumBands);
+        }
+    }
     lcd->setBatteryVoltage(pm_get_battery_voltage());
     idle_count++;
     return this;
@@ -802,10 +875,10 @@ void UIPlayMode::readTag()
         } else {
             track = 0;
         }
-        sprintf(str, "%d/%d", track, vars->num_tracks);
+        sprintf(str, "%d/%lu", track, (unsigned long) vars->num_tracks);
     } else {
-        uint16_t track = file_menu_get_ext_num_from_max("wav", 3, vars->idx_play + 1) + file_menu_get_ext_num_from_max("WAV", 3, vars->idx_play +1);
-        sprintf(str, "%d/%d", track, vars->num_tracks);
+        uint32_t track = file_menu_get_type_num_from_max(FILE_MENU_TYPE_AUDIO, vars->idx_play + 1);
+        sprintf(str, "%lu/%lu", (unsigned long) track, (unsigned long) vars->num_tracks);
     }
     lcd->setTrack(str);
     if (tag.getUTF8Title(str, sizeof(str) - 1)) {
@@ -822,6 +895,9 @@ void UIPlayMode::readTag()
     if (tag.getUTF8Artist(str, sizeof(str) - 1)) lcd->setArtist(str); else lcd->setArtist("");
     //if (tag.getUTF8Year(str, sizeof(str) - 1)) lcd->setYear(str); else lcd->setYear("");
 
+    // ReplayGain from TAG (applied through volume multiplier)
+    get_audio_codec()->setReplayGain(getReplayGainDb());
+
     {  // load image from TAG
         mime_t mime;
         ptype_t ptype;
@@ -840,11 +916,10 @@ void UIPlayMode::readTag()
     }
 
     if (loadImageFromDir) {  // load image from local directory
-        uint16_t idx = 0;
+        uint32_t idx = 0;
         bool loaded = false;
-        while (idx < file_menu_get_num()) {
-            if (file_menu_match_ext(idx, "jpg", 3) || file_menu_match_ext(idx, "JPG", 3) ||
-                file_menu_match_ext(idx, "jpeg", 4) || file_menu_match_ext(idx, "JPEG", 4)) {
+        while (file_menu_get_type_num(FILE_MENU_TYPE_IMAGE) > 0 && idx < file_menu_get_num()) {
+            if (file_menu_is_type(idx, FILE_MENU_TYPE_IMAGE)) {
                 file_menu_get_fname(idx, str, sizeof(str) - 1);
                 lcd->setImageJpeg(str);
                 loaded = true;
@@ -857,6 +932,16 @@ void UIPlayMode::readTag()
     return;
 }
 
+float UIPlayMode::getReplayGainDb() const
+{
+    auto replayGain = cfgMenu.get(ConfigMenuId::PLAY_REPLAY_GAIN);
+    float gainDb;
+    if (replayGain != ConfigMenu::ReplayGainOff && tag.getReplayGain(replayGain == ConfigMenu::ReplayGainAlbum, gainDb)) {
+        return gainDb;
+    }
+    return 0.0;
+}
+
 void UIPlayMode::play()
 {
     char str[FF_MAX_LFN];
@@ -871,6 +956,40 @@ void UIPlayMode::play()
     lcd->setSampleFreq(codec->getSampFreq());
     vars->fpos = 0;
     vars->samples_played = 0;
+    xfadeTried = false;
+    xfadeIdx = 0;
+}
+
+void UIPlayMode::startCrossfade(PlayAudio* codec)
+{
+    uint32_t fadeSec = cfgMenu.get(ConfigMenuId::PLAY_CROSSFADE);
+    if (fadeSec == 0 || codec->isPaused()) { return; }
+    if (codec->totalMillis() - codec->elapsedMillis() > fadeSec * 1000) { return; }
+    xfadeTried = true;  // only once per track
+    // crossfade to next audio file in the same folder
+    for (uint32_t idx = vars->idx_play + 1; idx < file_menu_get_num(); idx++) {
+        if (!isAudioFile(idx)) { continue; }
+        char str[FF_MAX_LFN];
+        memset(str, 0, sizeof(str));
+        file_menu_get_fname(idx, str, sizeof(str) - 1);
+        tag.loadFile(str);  // for ReplayGain of next voice, loaded again by readTag() at switching
+        if (codec->playNext(str, fadeSec * 1000, getReplayGainDb())) {
+            printf("%s\r\n", str);
+            xfadeIdx = idx;
+        }
+        return;
+    }
+}
+
+void UIPlayMode::switchToCrossfaded(PlayAudio* codec)
+{
+    // next track took over the decoder
+    vars->idx_play = xfadeIdx;
+    readTag();
+    lcd->setBitRes(codec->getBitsPerSample());
+    lcd->setSampleFreq(codec->getSampFreq());
+    xfadeTried = false;
+    xfadeIdx = 0;
 }
 
 void UIPlayMode::entry(UIMode* prevMode)
@@ -10,12 +10,15 @@
 
 #include <stack>
 
+#include "AlbumIndex.h"
 #include "ConfigMenu.h"
 #include "ConfigParam.h"
 #include "file_menu_FatFs.h"
 #include "LcdCanvas.h"
 #include "ui_control.h"
 
+class PlayAudio;
+
 typedef enum {
     None = 0,
     ImmediatePlay,
@@ -28,8 +31,8 @@ typedef enum {
 } next_play_type_t;
 
 typedef struct {
-    uint16_t head;
-    uint16_t column;
+    uint32_t head;
+    uint32_t column;
 } stack_data_t;
 
 struct UIVars
@@ -38,10 +41,10 @@ struct UIVars
     uint16_t num_list_lines = 1;
     ui_mode_enm_t init_dest_ui_mode = InitialMode;
     ui_mode_enm_t resume_ui_mode = FileViewMode;
-    uint16_t idx_head = 0;
-    uint16_t idx_column = 0;
-    uint16_t idx_play = 0;
-    uint16_t num_tracks = 0;
+    uint32_t idx_head = 0;
+    uint32_t idx_column = 0;
+    uint32_t idx_play = 0;
+    uint32_t num_tracks = 0;
     do_next_play_t do_next_play = None;
     next_play_type_t next_play_type = RandomPlay;
     size_t fpos = 0;
@@ -81,7 +84,7 @@ protected:
     static ConfigMenu& cfgMenu;
     static ConfigParam& cfgParam;
     static LcdCanvas* lcd;
-    bool isAudioFile(const uint16_t& idx) const;
+    bool isAudioFile(const uint32_t& idx) const;
     const char* name;
     UIMode* prevMode = nullptr;
     ui_mode_enm_t ui_mode_enm;
@@ -140,13 +143,18 @@ public:
     void draw() const;
 protected:
     uint16_t* sft_val;
+    bool listPending = false;
     void listIdxItems();
-    uint16_t getNumAudioFiles() const;
+    uint32_t getNumAudioFiles() const;
     void chdir() const;
     UIMode* nextPlay();
     UIMode* sequentialSearch(const bool& repeatFlg);
+    UIMode* siblingSearch(const bool& repeatFlg);
     UIMode* randomSearch(const uint16_t& depth);
     void findFirstAudioTrack() const;
+    uint32_t getDirOrders(uint32_t* orders) const;
+    bool openAlbum(const AlbumIndex::Album_t& album) const;
+    void openRoot() const;
     void idxInc() const;
     void idxDec() const;
     void idxFastInc() const;
@@ -167,9 +175,14 @@ public:
 protected:
     size_t tagImageSize = 0;
     bool loadImageFromDir = true;
+    bool xfadeTried = false;
+    uint32_t xfadeIdx = 0;  // next track being crossfaded in (0: none)
     void play();
+    void startCrossfade(PlayAudio* codec);
+    void switchToCrossfaded(PlayAudio* codec);
     //audio_codec_enm_t getAudioCodec(MutexFsBaseFile* f);
     void readTag();
+    float getReplayGainDb() const;  // of the file loaded in TagRead
 };
 
 //===================================
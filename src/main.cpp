@@ -13,6 +13,7 @@
 #include "hardware/gpio.h"
 
 #include "common.h"
+#include "io_service.h"
 #include "lcd.h"
 #include "power_manage.h"
 #include "UIMode.h"
@@ -79,6 +80,9 @@ int main() {
         printf("Static Battery Check\r\n");
     }
 
+    // FatFs access arbitration between core0 and core1
+    io_service_init();
+
     // UI initialize
     ui_init(board_type);
 
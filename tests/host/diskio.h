@@ -0,0 +1,22 @@
+/*-----------------------------------------------------------/
+/ Host stand-in of FatFs diskio.h for unit tests
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#pragma once
+
+#include "ff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum { RES_OK = 0, RES_ERROR, RES_WRPRT, RES_NOTRDY, RES_PARERR } DRESULT;
+DRESULT disk_read(BYTE pdrv, BYTE* buff, LBA_t sector, UINT count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,71 @@
+/*-----------------------------------------------------------/
+/ Host stand-in of FatFs ff.h for unit tests
+/   only the types and functions io_service, ReadBuffer and file_menu refer to
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FF_FS_READONLY 0
+#define FF_USE_CHMOD 1
+#define FF_USE_FASTSEEK 1
+#define FF_FS_EXFAT 0
+#define FF_MAX_SS 512
+#define FF_LFN_BUF 255
+
+#define FA_READ 0x01
+#define FA_WRITE 0x02
+#define FA_CREATE_ALWAYS 0x08
+#define AM_HID 0x02
+#define AM_DIR 0x10
+
+typedef unsigned int UINT;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint32_t LBA_t;
+typedef uint64_t FSIZE_t;
+typedef char TCHAR;
+
+typedef enum {
+    FR_OK = 0, FR_DISK_ERR, FR_INT_ERR, FR_NOT_READY, FR_NO_FILE, FR_NO_PATH, FR_INVALID_NAME, FR_DENIED,
+    FR_EXIST, FR_INVALID_OBJECT, FR_WRITE_PROTECTED, FR_INVALID_DRIVE, FR_NOT_ENABLED, FR_NO_FILESYSTEM,
+    FR_MKFS_ABORTED, FR_TIMEOUT, FR_LOCKED, FR_NOT_ENOUGH_CORE, FR_TOO_MANY_OPEN_FILES, FR_INVALID_PARAMETER
+} FRESULT;
+
+typedef struct { BYTE fs_type; BYTE pdrv; BYTE csize; LBA_t database; BYTE win[FF_MAX_SS]; } FATFS;
+typedef struct { FATFS* fs; BYTE stat; DWORD sclust; FSIZE_t objsize; } FFOBJID;
+typedef struct { FFOBJID obj; BYTE err; FSIZE_t fptr; DWORD* cltbl; } FIL;
+typedef struct { FFOBJID obj; DWORD dptr; DWORD clust; LBA_t sect; BYTE* dir; } DIR;
+typedef struct { FSIZE_t fsize; WORD fdate; WORD ftime; BYTE fattrib; TCHAR fname[FF_LFN_BUF + 1]; } FILINFO;
+
+FRESULT f_mount(FATFS* fs, const TCHAR* path, BYTE opt);
+FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode);
+FRESULT f_close(FIL* fp);
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br);
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw);
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs);
+FRESULT f_unlink(const TCHAR* path);
+FRESULT f_rename(const TCHAR* path_old, const TCHAR* path_new);
+FRESULT f_chmod(const TCHAR* path, BYTE attr, BYTE mask);
+FRESULT f_opendir(DIR* dp, const TCHAR* path);
+FRESULT f_closedir(DIR* dp);
+FRESULT f_readdir(DIR* dp, FILINFO* fno);
+FRESULT f_chdir(const TCHAR* path);
+
+#define f_size(fp) ((fp)->obj.objsize)
+#define f_tell(fp) ((fp)->fptr)
+#define f_eof(fp) ((int) ((fp)->fptr == (fp)->obj.objsize))
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,31 @@
+/*-----------------------------------------------------------/
+/ Host stand-in of hardware/sync.h for unit tests
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// tests run on a single thread, then spin locks are no-op
+typedef volatile uint32_t spin_lock_t;
+spin_lock_t* spin_lock_init(uint lock_num);
+int spin_lock_claim_unused(bool required);
+uint32_t spin_lock_blocking(spin_lock_t* lock);
+void spin_unlock(spin_lock_t* lock, uint32_t saved_irq);
+
+// __wfe() on a single thread never wakes up: it fails the test instead of hanging
+void __wfe(void);
+void __sev(void);
+void __dmb(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,392 @@
+/*-----------------------------------------------------------/
+/ Host stand-ins of pico-sdk and FatFs for unit tests
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#include "host_stub.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diskio.h"
+#include "hardware/sync.h"
+#include "pico/flash.h"
+#include "pico/multicore.h"
+#include "pico/stdlib.h"
+#include "pico/util/queue.h"
+#include "tf_card.h"
+
+static uint32_t host_time_us = 0;
+static uint32_t host_sev = 0;
+static spin_lock_t host_spin_lock;
+static int host_spin_held = 0;
+
+void (*host_f_access_hook)(UINT size) = NULL;
+
+uint32_t time_us_32(void) { return host_time_us; }
+void host_advance_us(uint32_t us) { host_time_us += us; }
+absolute_time_t get_absolute_time(void) { return host_time_us; }
+uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t) (t / 1000); }
+
+spin_lock_t* spin_lock_init(uint lock_num) { (void) lock_num; return &host_spin_lock; }
+int spin_lock_claim_unused(bool required) { (void) required; return 0; }
+uint32_t spin_lock_blocking(spin_lock_t* lock)
+{
+    (void) lock;
+    if (host_spin_held) {
+        fprintf(stderr, "FAIL: spin_lock_blocking() while held (deadlock on target)\n");
+        exit(1);
+    }
+    host_spin_held = 1;
+    return 0;
+}
+
+void spin_unlock(spin_lock_t* lock, uint32_t saved_irq) { (void) lock; (void) saved_irq; host_spin_held = 0; }
+int host_spin_lock_held(void) { return host_spin_held; }
+
+void __wfe(void)
+{
+    fprintf(stderr, "FAIL: __wfe() on single thread (lock never released)\n");
+    exit(1);
+}
+
+void __sev(void) { host_sev++; }
+uint32_t host_sev_count(void) { return host_sev; }
+void __dmb(void) {}
+
+bool flash_safe_execute_core_init(void) { return true; }
+void multicore_reset_core1(void) {}
+void multicore_launch_core1(void (*entry)(void)) { (void) entry; }
+
+void queue_init(queue_t* q, uint element_size, uint element_count)
+{
+    if (element_size > HOST_QUEUE_MAX_SIZE || element_count > HOST_QUEUE_MAX_COUNT) {
+        fprintf(stderr, "FAIL: queue_init() beyond host stand-in\n");
+        exit(1);
+    }
+    memset(q, 0, sizeof(queue_t));
+    q->element_size = element_size;
+    q->element_count = element_count;
+}
+
+bool queue_try_add(queue_t* q, const void* data)
+{
+    if (q->level >= q->element_count) { return false; }
+    memcpy(q->data[(q->rd + q->level) % q->element_count], data, q->element_size);
+    q->level++;
+    return true;
+}
+
+bool queue_try_remove(queue_t* q, void* data)
+{
+    if (q->level == 0) { return false; }
+    memcpy(data, q->data[q->rd], q->element_size);
+    q->rd = (q->rd + 1) % q->element_count;
+    q->level--;
+    return true;
+}
+
+void queue_remove_blocking(queue_t* q, void* data)
+{
+    if (!queue_try_remove(q, data)) {
+        fprintf(stderr, "FAIL: queue_remove_blocking() on empty queue (never filled)\n");
+        exit(1);
+    }
+}
+
+FRESULT f_mount(FATFS* fs, const TCHAR* path, BYTE opt) { (void) fs; (void) path; (void) opt; return FR_OK; }
+FRESULT f_close(FIL* fp) { (void) fp; return FR_OK; }
+FRESULT f_closedir(DIR* dp) { (void) dp; return FR_OK; }
+FRESULT f_chdir(const TCHAR* path) { (void) path; return FR_OK; }
+
+static FATFS host_fs;
+static int host_f_read_fails = 0;
+static FRESULT host_f_read_result = FR_OK;
+static uint32_t host_f_reads = 0;
+static uint32_t host_f_lseeks = 0;
+static uint32_t host_reboots = 0;
+static uint32_t host_disk_reads = 0;
+static uint32_t host_disk_sectors = 0;
+static uint32_t host_window_reads = 0;
+static uint32_t host_fat_lookups = 0;
+static const FIL* host_win_fp = NULL;  // sector window of FatFs (FIL::buf)
+static LBA_t host_win_sect = 0;
+static BYTE host_win[512];
+
+BYTE host_file_byte(FSIZE_t pos) { return (BYTE) (pos + (pos >> 8)); }
+void host_fail_f_read(int times, FRESULT fr) { host_f_read_fails = times; host_f_read_result = fr; }
+uint32_t host_f_read_count(void) { return host_f_reads; }
+uint32_t host_f_lseek_count(void) { return host_f_lseeks; }
+uint32_t host_reboot_spi_count(void) { return host_reboots; }
+void pico_fatfs_set_config(pico_fatfs_spi_config_t* config) { (void) config; }
+void pico_fatfs_reboot_spi(void) { host_reboots++; }
+uint32_t host_disk_read_count(void) { return host_disk_reads; }
+uint32_t host_disk_sector_count(void) { return host_disk_sectors; }
+uint32_t host_window_read_count(void) { return host_window_reads; }
+uint32_t host_fat_lookup_count(void) { return host_fat_lookups; }
+
+// entries of the directory in the order of f_readdir(), a slot of 32 bytes each
+// deleted ones are left as holes (as FAT does) so that positions of the others stay
+typedef struct {
+    TCHAR name[FF_LFN_BUF + 1];
+    BYTE attr;
+    BYTE deleted;
+    BYTE* data;  // NULL: the file on the disk image
+    FSIZE_t size;
+} host_ent_t;
+
+#define HOST_DIR_ENT_SIZE 32
+#define HOST_DIR_ENTS_PER_SECT (512 / HOST_DIR_ENT_SIZE)
+#define HOST_ENT_SCLUST 0x100000  // start cluster of files in RAM (+ index of the entry)
+static host_ent_t* host_ents = NULL;
+static uint32_t host_ent_num = 0;
+static uint32_t host_ent_cap = 0;
+static DWORD host_dir_sclust = 0x1000;
+static uint32_t host_f_readdirs = 0;
+static uint32_t host_dir_rewinds = 0;
+
+static FATFS* host_get_fs(void)
+{
+    host_fs.csize = HOST_CSIZE;
+    host_fs.database = HOST_DATABASE;
+    return &host_fs;
+}
+
+static host_ent_t* host_dir_append(const TCHAR* name, BYTE attr)
+{
+    if (host_ent_num == host_ent_cap) {
+        host_ent_cap = (host_ent_cap > 0) ? host_ent_cap * 2 : 256;
+        host_ents = (host_ent_t*) realloc(host_ents, sizeof(host_ent_t) * host_ent_cap);
+    }
+    host_ent_t* ent = &host_ents[host_ent_num++];
+    memset(ent, 0, sizeof(host_ent_t));
+    strncpy(ent->name, name, FF_LFN_BUF);
+    ent->attr = attr;
+    return ent;
+}
+
+static int host_dir_find(const TCHAR* path)
+{
+    if (path[0] == '/') { path++; }
+    for (uint32_t i = 0; i < host_ent_num; i++) {
+        if (!host_ents[i].deleted && strcmp(host_ents[i].name, path) == 0) { return (int) i; }
+    }
+    return -1;
+}
+
+void host_dir_add(const TCHAR* name, BYTE attr)
+{
+    host_ent_t* ent = host_dir_append(name, attr);
+    ent->size = (attr & AM_DIR) ? 0 : HOST_FILE_SIZE;
+}
+
+void host_dir_clear(void)
+{
+    for (uint32_t i = 0; i < host_ent_num; i++) { free(host_ents[i].data); }
+    host_ent_num = 0;
+    host_dir_sclust++;
+}
+
+int host_dir_exists(const TCHAR* name) { return host_dir_find(name) >= 0; }
+uint32_t host_f_readdir_count(void) { return host_f_readdirs; }
+uint32_t host_dir_rewind_count(void) { return host_dir_rewinds; }
+
+// directory occupies contiguous clusters from host_dir_sclust
+static void host_dir_locate(DIR* dp, DWORD dptr)
+{
+    DWORD sect = dptr / 512;
+    dp->dptr = dptr;
+    dp->clust = host_dir_sclust + sect / HOST_CSIZE;
+    dp->sect = HOST_DATABASE + (LBA_t) HOST_CSIZE * (dp->clust - 2) + sect % HOST_CSIZE;
+    dp->dir = dp->obj.fs->win + dptr % FF_MAX_SS;
+}
+
+FRESULT f_opendir(DIR* dp, const TCHAR* path)
+{
+    (void) path;
+    memset(dp, 0, sizeof(DIR));
+    dp->obj.fs = host_get_fs();
+    dp->obj.sclust = host_dir_sclust;
+    host_dir_locate(dp, 0);
+    return FR_OK;
+}
+
+// reads the entry at the position of DIR as dir_read() of FatFs, which fails if the sector is not of the position
+FRESULT f_readdir(DIR* dp, FILINFO* fno)
+{
+    if (fno == NULL) {
+        host_dir_rewinds++;
+        host_dir_locate(dp, 0);
+        return FR_OK;
+    }
+    host_f_readdirs++;
+    DIR expected = *dp;
+    host_dir_locate(&expected, dp->dptr);
+    if (dp->clust != expected.clust || dp->sect != expected.sect || dp->dir != expected.dir) { return FR_INT_ERR; }
+    uint32_t i = dp->dptr / HOST_DIR_ENT_SIZE;
+    while (i < host_ent_num && host_ents[i].deleted) { i++; }
+    if (i >= host_ent_num) {
+        fno->fname[0] = '\0';
+        return FR_OK;
+    }
+    const host_ent_t* ent = &host_ents[i];
+    strcpy(fno->fname, ent->name);
+    fno->fattrib = ent->attr;
+    fno->fsize = ent->size;
+    fno->fdate = (WORD) (i % 32 + 1);
+    fno->ftime = (WORD) (i % 60);
+    host_dir_locate(dp, (i + 1) * HOST_DIR_ENT_SIZE);
+    return FR_OK;
+}
+
+FRESULT f_open(FIL* fp, const TCHAR* path, BYTE mode)
+{
+    int i = host_dir_find(path);
+    if (mode & FA_CREATE_ALWAYS) {
+        if (i < 0) {
+            host_dir_append((path[0] == '/') ? path + 1 : path, 0);
+            i = (int) host_ent_num - 1;
+        }
+        free(host_ents[i].data);
+        host_ents[i].data = (BYTE*) malloc(1);
+        host_ents[i].size = 0;
+    }
+    if (i < 0 || (host_ents[i].attr & AM_DIR)) { return FR_NO_FILE; }
+    memset(fp, 0, sizeof(FIL));
+    fp->obj.fs = host_get_fs();
+    fp->obj.sclust = (host_ents[i].data != NULL) ? HOST_ENT_SCLUST + (DWORD) i : HOST_FILE_SCLUST;
+    fp->obj.objsize = host_ents[i].size;
+    if (host_win_fp == fp) { host_win_fp = NULL; }
+    return FR_OK;
+}
+
+static host_ent_t* host_fil_ent(const FIL* fp)
+{
+    return (fp->obj.sclust >= HOST_ENT_SCLUST) ? &host_ents[fp->obj.sclust - HOST_ENT_SCLUST] : NULL;
+}
+
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs)
+{
+    host_f_lseeks++;
+    if (fp->err != 0) { return (FRESULT) fp->err; }
+    fp->fptr = ofs;
+    return FR_OK;
+}
+
+FRESULT f_unlink(const TCHAR* path)
+{
+    int i = host_dir_find(path);
+    if (i < 0) { return FR_NO_FILE; }
+    free(host_ents[i].data);
+    host_ents[i].data = NULL;
+    host_ents[i].deleted = 1;
+    return FR_OK;
+}
+
+FRESULT f_rename(const TCHAR* path_old, const TCHAR* path_new)
+{
+    int i = host_dir_find(path_old);
+    if (i < 0) { return FR_NO_FILE; }
+    if (host_dir_find(path_new) >= 0) { return FR_EXIST; }
+    strncpy(host_ents[i].name, (path_new[0] == '/') ? path_new + 1 : path_new, FF_LFN_BUF);
+    return FR_OK;
+}
+
+FRESULT f_chmod(const TCHAR* path, BYTE attr, BYTE mask)
+{
+    int i = host_dir_find(path);
+    if (i < 0) { return FR_NO_FILE; }
+    host_ents[i].attr = (BYTE) ((host_ents[i].attr & ~mask) | (attr & mask));
+    return FR_OK;
+}
+
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br)
+{
+    if (host_f_access_hook != NULL) { host_f_access_hook(btr); }
+    host_f_reads++;
+    *br = 0;
+    if (fp->err != 0) { return (FRESULT) fp->err; }
+    if (host_f_read_fails > 0) {
+        host_f_read_fails--;
+        fp->err = (BYTE) host_f_read_result;
+        return host_f_read_result;
+    }
+    if (fp->fptr >= fp->obj.objsize) { return FR_OK; }
+    if (btr > fp->obj.objsize - fp->fptr) { btr = (UINT) (fp->obj.objsize - fp->fptr); }
+    host_ent_t* ent = host_fil_ent(fp);
+    if (ent != NULL) {
+        memcpy(buff, ent->data + fp->fptr, btr);
+        fp->fptr += btr;
+        *br = btr;
+        return FR_OK;
+    }
+    BYTE* rbuff = (BYTE*) buff;
+    const UINT ss = 512;
+    const FATFS* fs = fp->obj.fs;
+    while (btr > 0) {
+        LBA_t sect = fs->database + (LBA_t) fs->csize * (fp->obj.sclust - 2) + (LBA_t) (fp->fptr / ss);
+        UINT rcnt;
+        if (fp->fptr % ss == 0) {
+            UINT csect = (UINT) (fp->fptr / ss) & (fs->csize - 1);
+            if (csect == 0 && fp->cltbl == NULL) { host_fat_lookups++; }
+            UINT cc = btr / ss;
+            if (cc > 0) {  // whole sectors directly into the buffer up to the end of cluster
+                if (csect + cc > fs->csize) { cc = fs->csize - csect; }
+                if (disk_read(fs->pdrv, rbuff, sect, cc) != RES_OK) { fp->err = FR_DISK_ERR; return FR_DISK_ERR; }
+                rcnt = ss * cc;
+                fp->fptr += rcnt;
+                rbuff += rcnt;
+                *br += rcnt;
+                btr -= rcnt;
+                continue;
+            }
+        }
+        if (host_win_fp != fp || host_win_sect != sect) {
+            host_window_reads++;
+            if (disk_read(fs->pdrv, host_win, sect, 1) != RES_OK) { fp->err = FR_DISK_ERR; return FR_DISK_ERR; }
+            host_win_fp = fp;
+            host_win_sect = sect;
+        }
+        rcnt = ss - (UINT) (fp->fptr % ss);
+        if (rcnt > btr) { rcnt = btr; }
+        memcpy(rbuff, &host_win[fp->fptr % ss], rcnt);
+        fp->fptr += rcnt;
+        rbuff += rcnt;
+        *br += rcnt;
+        btr -= rcnt;
+    }
+    return FR_OK;
+}
+
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw)
+{
+    if (host_f_access_hook != NULL) { host_f_access_hook(btw); }
+    host_ent_t* ent = host_fil_ent(fp);
+    if (ent != NULL) {
+        if (fp->fptr + btw > ent->size) {
+            ent->data = (BYTE*) realloc(ent->data, fp->fptr + btw);
+            ent->size = fp->fptr + btw;
+            fp->obj.objsize = ent->size;
+        }
+        memcpy(ent->data + fp->fptr, buff, btw);
+    }
+    fp->fptr += btw;
+    *bw = btw;
+    return FR_OK;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE* buff, LBA_t sector, UINT count)
+{
+    (void) pdrv;
+    host_disk_reads++;
+    host_disk_sectors += count;
+    for (UINT i = 0; i < count * 512; i++) {
+        int64_t pos = ((int64_t) sector - HOST_FILE_LBA) * 512 + i;
+        buff[i] = (pos >= 0 && pos < HOST_FILE_SIZE) ? host_file_byte((FSIZE_t) pos) : 0;
+    }
+    return RES_OK;
+}
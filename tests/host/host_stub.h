@@ -0,0 +1,53 @@
+/*-----------------------------------------------------------/
+/ Hooks of host stand-ins for unit tests
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#pragma once
+
+#include "ff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void host_advance_us(uint32_t us);  // clock of time_us_32()
+uint32_t host_sev_count(void);  // calls of __sev()
+int host_spin_lock_held(void);  // spin lock is not released
+
+// called from f_read() and f_write() with the size of each call (NULL: none)
+extern void (*host_f_access_hook)(UINT size);
+
+// a single directory is opened by f_opendir() for any path, and its files by f_open() with their name
+// files added by host_dir_add() are HOST_FILE_SIZE bytes of host_file_byte(), stored contiguously
+// from cluster HOST_FILE_SCLUST of the disk image read by disk_read()
+// files created by f_open() with FA_CREATE_ALWAYS keep what is written in RAM
+void host_dir_add(const TCHAR* name, BYTE attr);
+void host_dir_clear(void);  // another empty directory (with another start cluster)
+int host_dir_exists(const TCHAR* name);
+uint32_t host_f_readdir_count(void);  // calls of f_readdir() reading an entry
+uint32_t host_dir_rewind_count(void);
+#define HOST_FILE_SIZE (1024 * 1024)
+#define HOST_CSIZE 64  // sectors per cluster
+#define HOST_DATABASE 8192
+#define HOST_FILE_SCLUST 3
+#define HOST_FILE_LBA (HOST_DATABASE + HOST_CSIZE * (HOST_FILE_SCLUST - 2))
+BYTE host_file_byte(FSIZE_t pos);
+// next 'times' calls of f_read() fail with 'fr' and leave the hard error in FIL::err as FatFs does
+void host_fail_f_read(int times, FRESULT fr);
+uint32_t host_f_read_count(void);
+uint32_t host_f_lseek_count(void);
+uint32_t host_reboot_spi_count(void);  // calls of pico_fatfs_reboot_spi()
+// f_read() transfers as FatFs R0.15 does: whole sectors by a multi-block disk_read() into the buffer,
+// partial sectors through the sector window of FIL, and a FAT lookup at each cluster without link map
+uint32_t host_disk_read_count(void);  // calls of disk_read() (a command to the card each)
+uint32_t host_disk_sector_count(void);
+uint32_t host_window_read_count(void);  // disk_read() of a single sector into the window
+uint32_t host_fat_lookup_count(void);
+
+#ifdef __cplusplus
+}
+#endif
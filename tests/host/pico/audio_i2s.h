@@ -0,0 +1,16 @@
+/*-----------------------------------------------------------/
+/ Host stand-in of pico/audio_i2s.h for unit tests
+/   only the types PlayAudio.h refers to
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#define PICO_AUDIO_I2S_BUFFER_SAMPLE_LENGTH 1152
+
+typedef struct { int dummy; } audio_buffer_pool_t;
@@ -0,0 +1,21 @@
+/*-----------------------------------------------------------/
+/ Host stand-in of pico/flash.h for unit tests
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool flash_safe_execute_core_init(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,29 @@
+/*-----------------------------------------------------------/
+/ Host stand-in of pico/stdlib.h for unit tests
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+
+// clock of the test, advanced only by host_advance_us()
+uint32_t time_us_32(void);
+typedef uint64_t absolute_time_t;
+absolute_time_t get_absolute_time(void);
+uint32_t to_ms_since_boot(absolute_time_t t);
+
+#ifdef __cplusplus
+}
+#endif
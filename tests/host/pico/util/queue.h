@@ -0,0 +1,36 @@
+/*-----------------------------------------------------------/
+/ Host stand-in of pico/util/queue.h for unit tests
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#pragma once
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HOST_QUEUE_MAX_COUNT 4
+#define HOST_QUEUE_MAX_SIZE 32
+
+typedef struct {
+    uint8_t data[HOST_QUEUE_MAX_COUNT][HOST_QUEUE_MAX_SIZE];
+    uint element_size;
+    uint element_count;
+    uint level;
+    uint rd;
+} queue_t;
+
+void queue_init(queue_t* q, uint element_size, uint element_count);
+bool queue_try_add(queue_t* q, const void* data);
+bool queue_try_remove(queue_t* q, void* data);
+// blocking on empty queue never returns on a single thread: it fails the test instead of hanging
+void queue_remove_blocking(queue_t* q, void* data);
+
+#ifdef __cplusplus
+}
+#endif
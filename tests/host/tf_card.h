@@ -0,0 +1,41 @@
+/*-----------------------------------------------------------/
+/ Host stand-in of tf_card.h (pico_fatfs) for unit tests
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "pico/stdlib.h"
+
+typedef struct {
+    void* spi_inst;
+    uint clk_slow;
+    uint clk_fast;
+    uint pin_miso;
+    uint pin_cs;
+    uint pin_sck;
+    uint pin_mosi;
+    bool pullup;
+} pico_fatfs_spi_config_t;
+
+#define spi0 NULL
+#define MHZ 1000000
+#define CLK_SLOW_DEFAULT (100 * 1000)
+#define PIN_SPI0_MISO_DEFAULT 4
+#define PIN_SPI0_CS_DEFAULT 5
+#define PIN_SPI0_SCK_DEFAULT 2
+#define PIN_SPI0_MOSI_DEFAULT 3
+
+void pico_fatfs_set_config(pico_fatfs_spi_config_t* config);
+void pico_fatfs_reboot_spi(void);
+
+#ifdef __cplusplus
+}
+#endif
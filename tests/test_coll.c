@@ -0,0 +1,214 @@
+/*-----------------------------------------------------------/
+/ Unit test of file_menu_coll (collation of file names)
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file_menu_coll.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+static int sign(int32_t v)
+{
+    return (v > 0) - (v < 0);
+}
+
+static void test_fold(void)
+{
+    CHECK(coll_fold('A') == 'a');
+    CHECK(coll_fold('z') == 'z');
+    CHECK(coll_fold('0') == '0');
+    CHECK(coll_fold(0x00C9) == 0x00E9); // E acute
+    CHECK(coll_fold(0x00D7) == 0x00D7); // multiplication sign
+    CHECK(coll_fold(0x0100) == 0x0101); // A macron
+    CHECK(coll_fold(0x0101) == 0x0101);
+    CHECK(coll_fold(0x0139) == 0x013A); // L acute (odd upper case)
+    CHECK(coll_fold(0x0178) == 0x00FF); // Y diaeresis
+    CHECK(coll_fold(0x0391) == 0x03B1); // Greek Alpha
+    CHECK(coll_fold(0x03A2) == 0x03A2); // reserved
+    CHECK(coll_fold(0x0410) == 0x0430); // Cyrillic A
+    CHECK(coll_fold(0x0401) == 0x0451); // Cyrillic Io
+    CHECK(coll_fold(0xFF21) == 0xFF41); // Fullwidth A
+}
+
+static void test_order(void)
+{
+    // each name comes after the previous one
+    static const char* const sorted[] = {
+        "01 Intro.wav",
+        "2 Song.wav",
+        "10 Song.wav",
+        "abc",
+        "ABD",
+        "The Beatles",
+        "Blur",
+        "disc9",
+        "disc10",
+        "disc0000000011",
+        "x99",
+        "x123456789012",
+        "zebra",
+        "\xc3\x81" "bc", // A acute
+        "\xc3\xa9" "clair", // e acute
+    };
+    const int n = sizeof(sorted) / sizeof(sorted[0]);
+    for (int i = 0; i < n; i++) {
+        CHECK(coll_strcmp(sorted[i], sorted[i]) == 0);
+        for (int j = i + 1; j < n; j++) {
+            if (coll_strcmp(sorted[i], sorted[j]) >= 0 || coll_strcmp(sorted[j], sorted[i]) <= 0) {
+                printf("FAIL order: \"%s\" < \"%s\"\n", sorted[i], sorted[j]);
+                failures++;
+            }
+        }
+    }
+}
+
+static void test_tie(void)
+{
+    // same collation, then bytewise comparison decides (never 0 for different names)
+    CHECK(coll_strcmp("Track 7", "track 007") != 0);
+    CHECK(sign(coll_strcmp("Track 7", "track 007")) == sign(strcmp("Track 7", "track 007")));
+    CHECK(sign(coll_strcmp("\xc3\x89" "clair", "\xc3\xa9" "clair")) == sign(strcmp("\xc3\x89" "clair", "\xc3\xa9" "clair")));
+}
+
+static void test_key(void)
+{
+    uint8_t key1[COLL_KEY_SZ];
+    uint8_t key2[COLL_KEY_SZ];
+    static const uint8_t expected[COLL_KEY_SZ] = {'a', 'b', 0};
+    coll_key("AB", key1);
+    CHECK(memcmp(key1, expected, COLL_KEY_SZ) == 0); // padded by 0
+    coll_key("Track 7", key1);
+    coll_key("track 007", key2);
+    CHECK(memcmp(key1, key2, COLL_KEY_SZ) == 0);
+    coll_key("The Who", key1);
+    coll_key("who", key2);
+    CHECK(memcmp(key1, key2, COLL_KEY_SZ) == 0);
+
+    // key is the head of collation: it never contradicts coll_strcmp
+    static const char* const names[] = {
+        "a", "A1", "a2", "a10", "The End", "end", "Long name with 12 chars", "Long name with 2 chars", "\xd0\x90", "\xd0\xb0\xd0\xb1",
+    };
+    const int n = sizeof(names) / sizeof(names[0]);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            coll_key(names[i], key1);
+            coll_key(names[j], key2);
+            int k = memcmp(key1, key2, COLL_KEY_SZ);
+            if (k != 0 && sign(k) != sign(coll_strcmp(names[i], names[j]))) {
+                printf("FAIL key: \"%s\" vs \"%s\"\n", names[i], names[j]);
+                failures++;
+            }
+        }
+    }
+}
+
+// Sort as file_menu does (collation key first, coll_strcmp() only on tie of keys)
+typedef struct {
+    uint8_t key[COLL_KEY_SZ];
+    const char* name;
+} bench_rec_t;
+
+static uint32_t bench_cmps;
+static uint32_t bench_full_cmps;
+
+static int bench_cmp_key(const void* a, const void* b)
+{
+    const bench_rec_t* rec1 = (const bench_rec_t*) a;
+    const bench_rec_t* rec2 = (const bench_rec_t*) b;
+    int result = memcmp(rec1->key, rec2->key, COLL_KEY_SZ);
+    bench_cmps++;
+    if (result == 0) {
+        result = coll_strcmp(rec1->name, rec2->name);
+        bench_full_cmps++;
+    }
+    return result;
+}
+
+static int bench_cmp_full(const void* a, const void* b)
+{
+    bench_cmps++;
+    bench_full_cmps++;
+    return coll_strcmp(((const bench_rec_t*) a)->name, ((const bench_rec_t*) b)->name);
+}
+
+static void bench_sort(const char* label, char (*names)[64], int n)
+{
+    bench_rec_t* recs = (bench_rec_t*) malloc(sizeof(bench_rec_t) * n);
+    for (int i = 0; i < n; i++) {
+        recs[i].name = names[i];
+    }
+    bench_cmps = 0;
+    bench_full_cmps = 0;
+    qsort(recs, n, sizeof(bench_rec_t), bench_cmp_full);
+    uint32_t full_only = bench_full_cmps;
+    for (int i = 0; i < n; i++) {
+        recs[i].name = names[i]; // same order as above
+        coll_key(names[i], recs[i].key);
+    }
+    bench_cmps = 0;
+    bench_full_cmps = 0;
+    qsort(recs, n, sizeof(bench_rec_t), bench_cmp_key);
+    printf("bench %s: %d entries, %lu compares, coll_strcmp %lu per sort (%lu without key)\n",
+        label, n, (unsigned long) bench_cmps, (unsigned long) bench_full_cmps, (unsigned long) full_only);
+    for (int i = 1; i < n; i++) {
+        if (coll_strcmp(recs[i - 1].name, recs[i].name) > 0) {
+            printf("FAIL bench %s: \"%s\" > \"%s\"\n", label, recs[i - 1].name, recs[i].name);
+            failures++;
+            break;
+        }
+    }
+    CHECK(bench_cmps == full_only); // same sort, same number of compares
+    CHECK(bench_full_cmps <= full_only);
+    free(recs);
+}
+
+static void bench_coll(void)
+{
+    // synthetic folders: distinct heads (tracks), shared heads (album titles), and a mix of both
+    const int n = 5000;
+    char (*names)[64] = (char (*)[64]) malloc(64 * n);
+    uint32_t seed = 1;
+    for (int i = 0; i < n; i++) {
+        snprintf(names[i], 64, "%d Track.wav", (i * 7) % n + 1);
+    }
+    bench_sort("tracks", names, n);
+    uint32_t full_tracks = bench_full_cmps;
+    for (int i = 0; i < n; i++) {
+        snprintf(names[i], 64, "Some Artist - Some Album %04d", (i * 7) % n);
+    }
+    bench_sort("albums", names, n);
+    for (int i = 0; i < n; i++) {
+        static const char* const words[] = {"The ", "", "a", "Best of ", "Disc ", "live "};
+        seed = seed * 1103515245 + 12345;
+        snprintf(names[i], 64, "%s%c%c%u.wav", words[(seed >> 16) % 6], 'A' + (seed >> 8) % 26, 'a' + (seed >> 20) % 26, (seed >> 4) % 1000);
+    }
+    bench_sort("mixed", names, n);
+    CHECK(full_tracks < (uint32_t) n / 100); // key decides almost every compare
+    free(names);
+}
+
+int main(void)
+{
+    test_fold();
+    test_order();
+    test_tie();
+    test_key();
+    bench_coll();
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
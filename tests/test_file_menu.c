@@ -0,0 +1,219 @@
+/*-----------------------------------------------------------/
+/ Unit test of file_menu_FatFs (sorted index of directory)
+/   and benchmark of f_readdir() calls and memory use
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "file_menu_FatFs.h"
+#include "file_menu_coll.h"
+#include "host_stub.h"
+#include "io_service.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+// as file_menu_FatFs.c (without PICO_RP2350)
+#define IDX_RAM_BUDGET (16*1024)
+#define IDX_FNAME ".file_menu.idx"
+#define IDX_TMP_FNAME ".file_menu.tmp"
+#define IDX_PREVIEW_RECS 16
+
+#define NAME_SZ 64
+
+static char (*names)[NAME_SZ] = NULL; // entries in the order of the directory
+static int names_num = 0;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Synthetic folder: an album folder every 10 entries, tracks and a few images otherwise (names are unique)
+static void make_dir(int n)
+{
+    static const char* const words[] = {"The ", "", "a", "Best of ", "Disc ", "live "};
+    uint32_t seed = 1;
+    host_dir_clear();
+    names = (char (*)[NAME_SZ]) realloc(names, NAME_SZ * n);
+    names_num = n;
+    for (int i = 0; i < n; i++) {
+        uint32_t id = ((uint32_t) i * 7919u) % 1000003u;
+        seed = seed * 1103515245 + 12345;
+        if (i % 10 == 0) {
+            snprintf(names[i], NAME_SZ, "Album %u", id);
+            host_dir_add(names[i], AM_DIR);
+        } else {
+            snprintf(names[i], NAME_SZ, "%s%c%u.%s", words[(seed >> 16) % 6], 'A' + (seed >> 8) % 26, id, (i % 50 == 1) ? "jpg" : "wav");
+            host_dir_add(names[i], 0);
+        }
+    }
+}
+
+static int name_pos(const char* name)
+{
+    for (int i = 0; i < names_num; i++) {
+        if (strcmp(names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+// ".." first, then directories and files, each in the order of coll_strcmp()
+static void check_listing(int n)
+{
+    char prev[FF_LFN_BUF + 1] = "";
+    char cur[FF_LFN_BUF + 1];
+    int prev_dir = 1;
+    uint32_t audio = 0;
+    int bad = 0;
+    CHECK(file_menu_get_num() == (uint32_t) n + 1);
+    CHECK(file_menu_get_dir_num() == (uint32_t) (n + 9) / 10);
+    CHECK(file_menu_get_fname(0, cur, sizeof(cur)) == FR_OK && strcmp(cur, "..") == 0);
+    for (uint32_t i = 1; i < file_menu_get_num(); i++) {
+        int is_dir = file_menu_is_dir(i);
+        if (file_menu_get_fname(i, cur, sizeof(cur)) != FR_OK) bad++;
+        if (i > 1 && (is_dir > prev_dir || (is_dir == prev_dir && coll_strcmp(prev, cur) >= 0))) {
+            if (bad == 0) printf("FAIL order %lu: \"%s\" \"%s\"\n", (unsigned long) i, prev, cur);
+            bad++;
+        }
+        if (file_menu_get_type_num_from_max(FILE_MENU_TYPE_AUDIO, i) != audio) bad++;
+        audio += file_menu_is_type(i, FILE_MENU_TYPE_AUDIO);
+        strcpy(prev, cur);
+        prev_dir = is_dir;
+    }
+    CHECK(bad == 0);
+    CHECK(file_menu_get_type_num(FILE_MENU_TYPE_AUDIO) == audio);
+}
+
+static void test_sort(void)
+{
+    const int n = 2000;
+    file_menu_stats_t stats;
+    make_dir(n);
+    CHECK(file_menu_open_dir("/") == FR_OK);
+    file_menu_full_sort();
+    check_listing(n);
+    file_menu_get_stats(&stats);
+    CHECK(!stats.cache_hit);
+    CHECK(host_dir_exists(IDX_FNAME));
+    CHECK(!host_dir_exists(IDX_TMP_FNAME));
+    file_menu_close_dir();
+    // the index file is reused while the directory is unchanged
+    file_menu_deinit(); // forget recently visited directories
+    uint8_t fs_type;
+    file_menu_init(&fs_type);
+    uint32_t readdirs = host_f_readdir_count();
+    CHECK(file_menu_open_dir("/") == FR_OK);
+    file_menu_full_sort();
+    file_menu_get_stats(&stats);
+    CHECK(stats.cache_hit);
+    CHECK(host_f_readdir_count() - readdirs < (uint32_t) n * 2); // scanned once for the signature
+    check_listing(n);
+    file_menu_close_dir();
+}
+
+// f_readdir() calls to list and to read names at random order (user-042)
+static void bench_seek(void)
+{
+    const int n = 5000;
+    const int accesses = 5000;
+    char fname[FF_LFN_BUF + 1];
+    make_dir(n);
+    uint32_t readdirs = host_f_readdir_count();
+    uint32_t rewinds = host_dir_rewind_count();
+    CHECK(file_menu_open_dir("/") == FR_OK);
+    file_menu_full_sort();
+    uint32_t build = host_f_readdir_count() - readdirs;
+    uint32_t build_rewinds = host_dir_rewind_count() - rewinds;
+    uint64_t former = 0;
+    int cursor = 0;
+    int bad = 0;
+    uint32_t seed = 7;
+    readdirs = host_f_readdir_count();
+    for (int i = 0; i < accesses; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t order = 1 + (seed >> 8) % n;
+        if (file_menu_get_fname(order, fname, sizeof(fname)) != FR_OK) bad++;
+        // former idx_f_stat(): rewinds if the entry is behind, then reads forward to it
+        int pos = name_pos(fname);
+        if (pos < 0) {
+            bad++;
+            continue;
+        }
+        former += (pos < cursor) ? pos + 1 : pos - cursor + 1;
+        cursor = pos + 1;
+    }
+    uint32_t random = host_f_readdir_count() - readdirs;
+    CHECK(bad == 0);
+    CHECK(random <= (uint32_t) accesses * 2); // hidden index files at most before an entry
+    CHECK(random * 100 < former);
+    printf("bench seek: %d entries, %lu f_readdir (%lu rewinds) to list, %d names at random order: %lu f_readdir (%.1f per name), %llu by former rewind and read forward\n",
+        n, (unsigned long) build, (unsigned long) build_rewinds, accesses, (unsigned long) random,
+        (double) random / accesses, (unsigned long long) former);
+    file_menu_close_dir();
+}
+
+// Time, f_readdir() calls and memory use to list large directories (user-045)
+static void bench_scale(void)
+{
+    static const int sizes[] = {1000, 10000, 100000};
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        const int n = sizes[k];
+        file_menu_stats_t stats;
+        make_dir(n);
+        uint32_t readdirs = host_f_readdir_count();
+        double t0 = now_ms();
+        CHECK(file_menu_open_dir("/") == FR_OK);
+        while (!file_menu_is_ready(IDX_PREVIEW_RECS)) file_menu_idle(true);
+        double t1 = now_ms();
+        file_menu_full_sort();
+        double t2 = now_ms();
+        file_menu_get_stats(&stats);
+        printf("bench scale: %d entries, first page %.1f ms, sorted %.1f ms, %lu f_readdir, %lu runs, %lu full compares, RAM %lu bytes (peak %lu)%s\n",
+            n, t1 - t0, t2 - t0, (unsigned long) (host_f_readdir_count() - readdirs), (unsigned long) stats.runs,
+            (unsigned long) stats.full_cmps, (unsigned long) stats.ram_bytes, (unsigned long) stats.peak_bytes,
+            stats.paged ? ", paged" : "");
+        CHECK(stats.num == (uint32_t) n + 1);
+        CHECK(stats.peak_bytes >= stats.ram_bytes);
+        CHECK(stats.peak_bytes <= IDX_RAM_BUDGET * 2); // bounded regardless of the number of entries
+        if (n >= 10000) {
+            CHECK(stats.runs > 0);
+            CHECK(stats.paged);
+        }
+        check_listing(n);
+        CHECK(!host_dir_exists(IDX_TMP_FNAME));
+        file_menu_close_dir();
+    }
+}
+
+int main(void)
+{
+    uint8_t fs_type;
+    io_service_init();
+    CHECK(file_menu_init(&fs_type) == FR_OK);
+    file_menu_set_ext_type("wav", FILE_MENU_TYPE_AUDIO);
+    file_menu_set_ext_type("jpg", FILE_MENU_TYPE_IMAGE);
+    test_sort();
+    bench_seek();
+    bench_scale();
+    file_menu_deinit();
+    free(names);
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*-----------------------------------------------------------/
+/ Unit test of io_service (FatFs access arbitration)
+/------------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/-----------------------------------------------------------*/
+
+#include <stdio.h>
+
+#include "host_stub.h"
+#include "io_service.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+static void test_exclusive(void)
+{
+    CHECK(io_try_lock(IO_REQ_DIR));
+    CHECK(!io_try_lock(IO_REQ_META));
+    CHECK(!io_try_lock(IO_REQ_DIR));
+    io_unlock(IO_REQ_DIR);
+    CHECK(io_try_lock(IO_REQ_META));
+    io_unlock(IO_REQ_META);
+    io_lock(IO_REQ_IMAGE); // free, then it doesn't wait
+    io_unlock(IO_REQ_IMAGE);
+}
+
+static void test_audio_priority(void)
+{
+    io_stats_t before, after;
+    io_get_stats(IO_REQ_AUDIO, &before);
+    CHECK(io_try_lock(IO_REQ_DIR));
+    host_advance_us(100);
+    CHECK(!io_try_lock(IO_REQ_AUDIO)); // claims priority
+    io_unlock(IO_REQ_DIR);
+    // others stay away while audio claims
+    CHECK(!io_try_lock(IO_REQ_DIR));
+    CHECK(!io_try_lock(IO_REQ_IMAGE));
+    host_advance_us(50);
+    CHECK(io_try_lock(IO_REQ_AUDIO)); // acquired as soon as released
+    io_get_stats(IO_REQ_AUDIO, &after);
+    CHECK(after.count == before.count + 1);
+    CHECK(after.max_wait_us == 50); // since the first attempt
+    io_unlock(IO_REQ_AUDIO);
+    CHECK(io_try_lock(IO_REQ_DIR));
+    io_unlock(IO_REQ_DIR);
+}
+
+static void test_cancel(void)
+{
+    CHECK(io_try_lock(IO_REQ_META));
+    CHECK(!io_try_lock(IO_REQ_AUDIO));
+    io_unlock(IO_REQ_META);
+    uint32_t sev = host_sev_count();
+    io_cancel(IO_REQ_AUDIO); // audio has nothing to read any more
+    CHECK(host_sev_count() > sev); // waiters are woken
+    CHECK(io_try_lock(IO_REQ_META));
+    io_unlock(IO_REQ_META);
+    io_cancel(IO_REQ_DIR); // no effect for others
+    CHECK(io_try_lock(IO_REQ_DIR));
+    io_unlock(IO_REQ_DIR);
+}
+
+static void test_stats(void)
+{
+    io_stats_t before, after;
+    io_get_stats(IO_REQ_DIR, &before);
+    io_lock(IO_REQ_DIR);
+    io_unlock(IO_REQ_DIR);
+    CHECK(io_try_lock(IO_REQ_DIR));
+    CHECK(!io_try_lock(IO_REQ_META)); // failure is not counted
+    io_unlock(IO_REQ_DIR);
+    io_get_stats(IO_REQ_DIR, &after);
+    CHECK(after.count == before.count + 2);
+    CHECK(after.max_wait_us == before.max_wait_us); // acquired at once
+    CHECK(!host_spin_lock_held());
+    io_print_stats();
+    CHECK(!host_spin_lock_held());
+}
+
+static int access_calls;
+static UINT access_max;
+static int access_unlocked;
+
+static void access_hook(UINT size)
+{
+    access_calls++;
+    if (size > access_max) { access_max = size; }
+    // lock is held during each FatFs call
+    if (io_try_lock(IO_REQ_IMAGE)) {
+        access_unlocked++;
+        io_unlock(IO_REQ_IMAGE);
+    }
+}
+
+static void test_chunked_access(void)
+{
+    static BYTE buf[IO_CHUNK_SIZE * 3];
+    FIL fil;
+    UINT br, bw;
+    host_f_access_hook = access_hook;
+    host_dir_add("a", 0);
+
+    access_calls = 0; access_max = 0; access_unlocked = 0;
+    CHECK(io_f_open(IO_REQ_META, &fil, "a", FA_READ) == FR_OK);
+    CHECK(io_f_read(IO_REQ_META, &fil, buf, IO_CHUNK_SIZE * 2 + 100, &br) == FR_OK);
+    CHECK(br == IO_CHUNK_SIZE * 2 + 100);
+    CHECK(access_calls == 3); // split not to block audio for long
+    CHECK(access_max == IO_CHUNK_SIZE);
+    CHECK(access_unlocked == 0);
+
+    access_calls = 0; access_max = 0;
+    CHECK(io_f_read(IO_REQ_AUDIO, &fil, buf, sizeof(buf), &br) == FR_OK);
+    CHECK(br == sizeof(buf));
+    CHECK(access_calls == 1); // audio reads at once
+
+    access_calls = 0; access_max = 0;
+    CHECK(io_f_write(IO_REQ_DIR, &fil, buf, IO_CHUNK_SIZE + 1, &bw) == FR_OK);
+    CHECK(bw == IO_CHUNK_SIZE + 1);
+    CHECK(access_calls == 2);
+    CHECK(access_unlocked == 0);
+    CHECK(io_f_close(IO_REQ_META, &fil) == FR_OK);
+
+    host_f_access_hook = NULL;
+    CHECK(io_try_lock(IO_REQ_DIR)); // every wrapper released the lock
+    io_unlock(IO_REQ_DIR);
+}
+
+static int idle_calls;
+static bool idle_may_write;
+
+static bool idle_task(bool may_write)
+{
+    idle_may_write = may_write;
+    return idle_calls++ < 2;
+}
+
+static void test_idle_task(void)
+{
+    CHECK(!io_run_idle_task(true));
+    io_set_idle_task(idle_task);
+    CHECK(io_run_idle_task(true));
+    CHECK(idle_may_write);
+    CHECK(io_run_idle_task(false));
+    CHECK(!idle_may_write); // passed through while a stream is filling
+    CHECK(!io_run_idle_task(true)); // nothing to do
+    io_set_idle_task(NULL);
+    CHECK(!io_run_idle_task(true));
+    CHECK(idle_calls == 3);
+}
+
+int main(void)
+{
+    io_service_init();
+    test_exclusive();
+    test_audio_priority();
+    test_cancel();
+    test_stats();
+    test_chunked_access();
+    test_idle_task();
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
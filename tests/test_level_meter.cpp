@@ -0,0 +1,179 @@
+/*------------------------------------------------------/
+/ Unit test of LevelMeter
+/-------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/------------------------------------------------------*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "LevelMeter.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+static bool near(float a, float b, float tol)
+{
+    return std::fabs(a - b) <= tol;
+}
+
+// feed sine of amplitude in dBFS (Q31) until a window closes
+static void feedSine(LevelMeter& meter, uint32_t sampFreq, float dbfs, uint32_t& phase)
+{
+    const double Pi = 3.14159265358979;
+    const double amp = 2147483647.0 * std::pow(10.0, dbfs / 20.0);
+    while (!meter.isReady()) {
+        meter.feed(static_cast<int32_t>(amp * std::sin(2.0 * Pi * 997.0 * phase / sampFreq)));
+        phase++;
+    }
+    meter.integrate();
+}
+
+static void testDb()
+{
+    CHECK(LevelMeter::powerToDbQ8(1u << 30) == 0);  // full scale
+    CHECK(LevelMeter::powerToDbQ8(1u << 29) == -771);  // -3.01 dB
+    CHECK(std::abs(LevelMeter::powerToDbQ8((1u << 30) / 10) + 10 * 256) <= 17);  // -10 dB within 6 bit mantissa step (0.067 dB)
+    CHECK(LevelMeter::powerToDbQ8(0) < -LevelMeter::DbRange * 256);
+    CHECK(LevelMeter::dbQ8ToLevel(0) == 1.0f);
+    CHECK(LevelMeter::dbQ8ToLevel(256) == 1.0f);
+    CHECK(LevelMeter::dbQ8ToLevel(-LevelMeter::DbRange * 256) == 0.0f);
+    CHECK(near(LevelMeter::dbQ8ToLevel(-LevelMeter::DbRange * 256 / 2), 0.5f, 1e-6f));
+}
+
+static void testSine()
+{
+    const float Range = LevelMeter::DbRange;
+    uint32_t phase = 0;
+    LevelMeter meter;
+    meter.setSampFreq(44100);
+    meter.reset();
+    feedSine(meter, 44100, 0.0f, phase);
+    CHECK(near(meter.getRms(), (Range - 3.01f) / Range, 0.005f));
+    CHECK(near(meter.getPeak(), 1.0f, 0.005f));
+    feedSine(meter, 44100, -20.0f, phase);
+    CHECK(near(meter.getRms(), (Range - 23.01f) / Range, 0.005f));
+    CHECK(near(meter.getPeak(), (Range - 20.0f) / Range, 0.005f));
+    for (int i = 0; i < 2; i++) {
+        meter.feed(0);
+    }
+    meter.integrate();
+    CHECK(meter.getRms() == 0.0f);  // silence
+}
+
+static void testSampFreq()
+{
+    // level doesn't depend on sampling rate
+    const uint32_t freqs[] = {44100, 48000, 96000, 192000};
+    float rms[4];
+    for (int i = 0; i < 4; i++) {
+        uint32_t phase = 0;
+        LevelMeter meter;
+        meter.setSampFreq(freqs[i]);
+        meter.reset();
+        CHECK(!meter.isReady());
+        feedSine(meter, freqs[i], -6.0f, phase);
+        rms[i] = meter.getRms();
+    }
+    for (int i = 1; i < 4; i++) {
+        CHECK(near(rms[i], rms[0], 0.005f));
+    }
+}
+
+static void testPeakHold()
+{
+    uint32_t phase = 0;
+    LevelMeter meter;
+    meter.setSampFreq(48000);
+    meter.reset();
+    feedSine(meter, 48000, -1.0f, phase);
+    const float loud = meter.getPeakHold();
+    int windows = 0;
+    // held for a second after the peak, then follows the signal
+    while (meter.getPeakHold() == loud && windows < 200) {
+        feedSine(meter, 48000, -40.0f, phase);
+        windows++;
+    }
+    CHECK(windows >= 1000 / 13 - 1 && windows <= 1000 / 13 + 2);
+    CHECK(near(meter.getPeakHold(), meter.getPeak(), 1e-6f));
+}
+
+// former level accumulation of PlayWav::decode() (per sample, replaced by LevelMeter)
+class FormerLevel
+{
+public:
+    explicit FormerLevel(uint32_t sampFreq) : accum(0), accumCount(0), sampFreq(sampFreq) {}
+    inline void feed(int32_t buf_s32)
+    {
+        accum += (buf_s32/65536) * (buf_s32/65536) / 32768 * 44100 / sampFreq;  // normalized to 44100 Hz's level
+        accumCount++;
+    }
+    uint32_t accum;
+    uint32_t accumCount;
+private:
+    volatile uint32_t sampFreq;  // member read in decode IRQ
+};
+
+// per-sample cost of the former accumulation and LevelMeter on the same test tone
+// (on RP2040 the division by sampFreq of the former one is a library call, the host only shows the trend)
+static void benchCost()
+{
+    using Clock = std::chrono::steady_clock;
+    const uint32_t SampFreq = 48000;
+    const int Frames = 1152;  // a buffer
+    const int Buffers = 4000;
+    const double Pi = 3.14159265358979;
+    std::vector<int32_t> tone(Frames);
+    for (int i = 0; i < Frames; i++) {
+        tone[i] = static_cast<int32_t>(2147483647.0 * 0.5 * std::sin(2.0 * Pi * 997.0 * i / SampFreq));  // -6 dBFS
+    }
+    double nsFormer = 1e30, nsMeter = 1e30;
+    uint32_t sink = 0;
+    for (int trial = 0; trial < 5; trial++) {
+        FormerLevel former(SampFreq);
+        auto t0 = Clock::now();
+        for (int b = 0; b < Buffers; b++) {
+            for (int i = 0; i < Frames; i++) { former.feed(tone[i]); }
+            sink += former.accum / former.accumCount;  // per buffer as decode did
+            former.accum = 0;
+            former.accumCount = 0;
+        }
+        auto t1 = Clock::now();
+        LevelMeter meter;
+        meter.setSampFreq(SampFreq);
+        meter.reset();
+        for (int b = 0; b < Buffers; b++) {
+            for (int i = 0; i < Frames; i++) { meter.feed(tone[i]); }
+            if (meter.isReady()) { meter.integrate(); }  // per buffer as decode does
+        }
+        auto t2 = Clock::now();
+        sink += static_cast<uint32_t>(meter.getRms() * 1000);
+        double samples = static_cast<double>(Frames) * Buffers;
+        nsFormer = std::min(nsFormer, std::chrono::duration<double, std::nano>(t1 - t0).count() / samples);
+        nsMeter = std::min(nsMeter, std::chrono::duration<double, std::nano>(t2 - t1).count() / samples);
+    }
+    printf("bench: former accumulation %.2f ns/sample, LevelMeter %.2f ns/sample (%u)\n", nsFormer, nsMeter, sink & 1);
+    CHECK(nsMeter < nsFormer);
+}
+
+int main()
+{
+    testDb();
+    testSine();
+    testSampFreq();
+    testPeakHold();
+    benchCost();
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
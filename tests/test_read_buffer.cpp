@@ -0,0 +1,305 @@
+/*------------------------------------------------------/
+/ Unit test of ReadBuffer (read retry on card error)
+/   and benchmark of the transfers to stream a file
+/-------------------------------------------------------/
+/ Copyright (c) 2025, Elehobica
+/ Released under the BSD-2-Clause
+/ refer to https://opensource.org/licenses/BSD-2-Clause
+/------------------------------------------------------*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "host_stub.h"
+#include "io_service.h"
+#include "ReadBuffer.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+// core1 side of ReadBuffer is called directly instead of fillLoop()
+class ReadBufferTest
+{
+public:
+    static constexpr int MaxRetries = ReadBuffer::MAX_RETRIES;
+    static constexpr uint32_t RetryWaitUs = ReadBuffer::RETRY_WAIT_MS * 1000;
+    static constexpr size_t ChunkSize = ReadBuffer::CHUNK_SIZE;
+    static constexpr size_t NumChunks = ReadBuffer::NUM_CHUNKS;
+    static void bind(ReadBuffer* rb, FIL* fp)
+    {
+        rb->reqBindAsync(fp);
+        rb->serviceReq();
+        rb->isBindDone();  // take the response
+    }
+    static bool fillOnce(ReadBuffer* rb, size_t maxChunks) { return rb->fillOnce(maxChunks); }
+    static int retry(const ReadBuffer* rb) { return rb->_retry; }
+    static bool filling(const ReadBuffer* rb) { return rb->_filling; }
+    static uint32_t giveUpCount() { return ReadBuffer::_giveUpCount; }
+    static uint32_t retryCount() { return ReadBuffer::_retryCount; }
+};
+using T = ReadBufferTest;
+
+static bool lockIsFree()
+{
+    if (!io_try_lock(IO_REQ_DIR)) { return false; }
+    io_unlock(IO_REQ_DIR);
+    return true;
+}
+
+static bool dataMatches(ReadBuffer* rb, size_t pos)
+{
+    const uint8_t* buf = rb->buf();
+    for (size_t i = 0; i < rb->getContiguous(); i++) {
+        if (buf[i] != host_file_byte(pos + i)) { return false; }
+    }
+    return true;
+}
+
+static void testRecover()
+{
+    FIL fil;
+    ReadBuffer* rb = new ReadBuffer();
+    f_open(&fil, "a", FA_READ);
+    T::bind(rb, &fil);
+    CHECK(T::filling(rb));
+
+    uint32_t reads = host_f_read_count();
+    uint32_t seeks = host_f_lseek_count();
+    uint32_t reboots = host_reboot_spi_count();
+    uint32_t errors = ReadBuffer::getErrorCount();
+    uint32_t retries = T::retryCount();
+    host_fail_f_read(2, FR_DISK_ERR);
+
+    CHECK(T::fillOnce(rb, T::NumChunks));  // fails, retry is scheduled
+    CHECK(rb->getLeft() == 0);
+    CHECK(T::retry(rb) == 1);
+    CHECK(fil.err != 0);
+    CHECK(ReadBuffer::getErrorCount() == errors + 1);
+    CHECK(lockIsFree());
+
+    CHECK(T::fillOnce(rb, T::NumChunks));  // waits without the lock
+    CHECK(host_f_read_count() == reads + 1);
+    CHECK(host_reboot_spi_count() == reboots);
+
+    host_advance_us(T::RetryWaitUs);
+    CHECK(T::fillOnce(rb, T::NumChunks));  // reboot, seek and fail again
+    CHECK(host_reboot_spi_count() == reboots + 1);
+    CHECK(host_f_lseek_count() == seeks + 1);
+    CHECK(T::retry(rb) == 2);
+    CHECK(rb->getLeft() == 0);
+
+    host_advance_us(T::RetryWaitUs);
+    CHECK(T::fillOnce(rb, T::NumChunks));  // wait is longer for later retry
+    CHECK(host_f_read_count() == reads + 2);
+    host_advance_us(T::RetryWaitUs);
+    CHECK(T::fillOnce(rb, T::NumChunks));  // recovered
+    CHECK(host_reboot_spi_count() == reboots + 2);
+    CHECK(host_f_lseek_count() == seeks + 2);
+    CHECK(host_f_read_count() == reads + 3);
+    CHECK(T::retry(rb) == 0);
+    CHECK(fil.err == 0);  // hard error of FIL is cleared before the retry
+    CHECK(rb->getLeft() > 0);
+    CHECK(dataMatches(rb, 0));  // from the position of the failed read
+    CHECK(!rb->reachedEod());
+    CHECK(T::retryCount() == retries + 2);
+    CHECK(ReadBuffer::getErrorCount() == errors + 2);
+    CHECK(lockIsFree());
+    delete rb;
+}
+
+static void testGiveUp()
+{
+    FIL fil;
+    ReadBuffer* rb = new ReadBuffer();
+    f_open(&fil, "b", FA_READ);
+    T::bind(rb, &fil);
+    CHECK(T::fillOnce(rb, 1));
+    CHECK(rb->getLeft() == T::ChunkSize);
+
+    uint32_t reads = host_f_read_count();
+    uint32_t giveUps = T::giveUpCount();
+    uint32_t errors = ReadBuffer::getErrorCount();
+    host_fail_f_read(T::MaxRetries + 1, FR_DISK_ERR);
+    // as fillLoop() does while the stream is filling, with the clock running
+    int calls = 0;
+    while (T::filling(rb) && calls < 1000) {
+        CHECK(T::fillOnce(rb, T::NumChunks));
+        host_advance_us(1000);
+        calls++;
+    }
+    CHECK(!T::filling(rb));  // gave up in bounded time
+    CHECK(calls < 100);
+    CHECK(rb->reachedEod());  // the track ends gracefully
+    CHECK(host_f_read_count() == reads + T::MaxRetries + 1);
+    CHECK(T::giveUpCount() == giveUps + 1);
+    CHECK(ReadBuffer::getErrorCount() == errors + T::MaxRetries + 1);
+    CHECK(rb->getLeft() == T::ChunkSize);  // data read before the error is still played
+    CHECK(dataMatches(rb, 0));
+    CHECK(lockIsFree());
+    host_fail_f_read(0, FR_OK);
+    delete rb;
+}
+
+// transfers to the card per MB and host throughput of streaming the whole file
+// (stream() verifies data if intact is given, which is out of the timed run)
+struct StreamCost {
+    double mbps;
+    double cmdsPerMb;  // disk_read() calls
+    double windowPerMb;  // single sector reads through the window of FatFs
+    uint32_t windowReads;
+    double fatPerMb;  // cluster lookups in FAT
+    double usPerMb;  // host time
+    uint32_t reads;  // f_read() calls
+    bool aligned;  // every f_read() after the first is a multiple of CHUNK_SIZE except the last
+    bool intact;  // data read matches the file
+};
+
+static std::vector<UINT> readSizes;
+static void recordRead(UINT size) { readSizes.push_back(size); }
+
+template <typename F>
+static StreamCost measure(F stream)
+{
+    using Clock = std::chrono::steady_clock;
+    StreamCost cost = {};
+    uint32_t cmds = host_disk_read_count();
+    uint32_t window = host_window_read_count();
+    uint32_t fat = host_fat_lookup_count();
+    readSizes.clear();
+    host_f_access_hook = recordRead;
+    size_t bytes = stream(&cost.intact);
+    host_f_access_hook = nullptr;
+    double mb = static_cast<double>(bytes) / (1024 * 1024);
+    cost.cmdsPerMb = (host_disk_read_count() - cmds) / mb;
+    cost.windowReads = host_window_read_count() - window;
+    cost.windowPerMb = cost.windowReads / mb;
+    cost.fatPerMb = (host_fat_lookup_count() - fat) / mb;
+    double sec = 1e9;
+    for (int i = 0; i < 5; i++) {
+        auto t0 = Clock::now();
+        stream(nullptr);
+        auto t1 = Clock::now();
+        sec = std::min(sec, std::chrono::duration<double>(t1 - t0).count());
+    }
+    cost.mbps = mb / sec;
+    cost.usPerMb = sec * 1e6 / mb;
+    cost.reads = static_cast<uint32_t>(readSizes.size());
+    cost.aligned = true;
+    for (size_t i = 1; i + 1 < readSizes.size(); i++) {
+        cost.aligned &= (readSizes[i] % T::ChunkSize) == 0;
+    }
+    return cost;
+}
+
+// former fillLoop(): f_read of 6912-byte secondary buffers regardless of sector boundary
+static size_t streamFormer(bool* intact)
+{
+    constexpr UINT SecondaryBufferSize = 6912;
+    static uint8_t buf[SecondaryBufferSize];
+    FIL fil;
+    f_open(&fil, "c", FA_READ);
+    size_t pos = 0;
+    bool ok = true;
+    while (!f_eof(&fil)) {
+        UINT br;
+        if (f_read(&fil, buf, SecondaryBufferSize, &br) != FR_OK || br == 0) { ok = false; break; }
+        for (UINT i = 0; intact != nullptr && i < br; i++) { ok &= (buf[i] == host_file_byte(pos + i)); }
+        pos += br;
+    }
+    if (intact != nullptr) { *intact = ok; }
+    return pos;
+}
+
+// ReadBuffer filled as fillLoop() does and drained as the decoder does
+// cltbl: cluster link map given by fast seek setup (nullptr: follow FAT chain)
+static size_t streamRing(size_t start, bool* intact, DWORD* cltbl = nullptr)
+{
+    FIL fil;
+    ReadBuffer* rb = new ReadBuffer();
+    f_open(&fil, "d", FA_READ);
+    fil.cltbl = cltbl;
+    f_lseek(&fil, start);
+    T::bind(rb, &fil);
+    size_t pos = start;
+    bool ok = true;
+    for (int i = 0; i < 100000; i++) {
+        T::fillOnce(rb, T::NumChunks);
+        while (rb->getLeft() > 0) {
+            if (intact != nullptr) { ok &= dataMatches(rb, pos); }
+            pos += rb->getContiguous();
+            rb->shift(rb->getContiguous());
+        }
+        if (rb->reachedEod()) { break; }
+    }
+    ok &= (pos == f_size(&fil));
+    if (intact != nullptr) { *intact = ok; }
+    delete rb;
+    return pos - start;
+}
+
+static void benchStream()
+{
+    StreamCost former = measure(streamFormer);
+    StreamCost ring = measure([](bool* intact) { return streamRing(0, intact); });
+    StreamCost ringUnaligned = measure([](bool* intact) { return streamRing(1000, intact); });
+    CHECK(former.intact);
+    CHECK(ring.intact);
+    CHECK(ringUnaligned.intact);
+    CHECK(ring.aligned);
+    CHECK(ringUnaligned.aligned);
+    CHECK(ring.windowPerMb == 0);
+    CHECK(ringUnaligned.windowReads == 1);  // only the head of the first read
+    CHECK(ring.cmdsPerMb < former.cmdsPerMb);
+    printf("bench: former 6912-byte f_read: %.0f MB/s, %u f_read, %.0f disk_read/MB (%.0f through window)\n",
+        former.mbps, former.reads, former.cmdsPerMb, former.windowPerMb);
+    printf("bench: ring of %u-byte chunks: %.0f MB/s, %u f_read, %.0f disk_read/MB (%.0f through window)\n",
+        static_cast<unsigned>(T::ChunkSize), ring.mbps, ring.reads, ring.cmdsPerMb, ring.windowPerMb);
+    printf("bench: ring bound at unaligned position: %.0f MB/s, %u f_read, %.0f disk_read/MB (%.1f through window)\n",
+        ringUnaligned.mbps, ringUnaligned.reads, ringUnaligned.cmdsPerMb, ringUnaligned.windowPerMb);
+}
+
+// raw sector reads of contiguous file against f_read following FAT chain
+static void benchRaw()
+{
+    constexpr DWORD Clusters = HOST_FILE_SIZE / (HOST_CSIZE * 512);
+    static DWORD clmt[4] = {4, Clusters, HOST_FILE_SCLUST, 0};  // single fragment
+    StreamCost chain = measure([](bool* intact) { return streamRing(0, intact); });
+    StreamCost raw = measure([](bool* intact) { return streamRing(0, intact, clmt); });
+    StreamCost rawUnaligned = measure([](bool* intact) { return streamRing(1000, intact, clmt); });
+    CHECK(chain.intact);
+    CHECK(raw.intact);
+    CHECK(rawUnaligned.intact);
+    CHECK(chain.fatPerMb > 0);
+    CHECK(raw.reads == 0);  // every read by disk_read
+    CHECK(raw.fatPerMb == 0);
+    CHECK(rawUnaligned.reads == 1);  // only the first read is not sector aligned
+    CHECK(rawUnaligned.fatPerMb == 0);
+    printf("bench: f_read by FAT chain: %.0f us/MB, %u f_read, %.0f disk_read/MB, %.0f FAT lookup/MB\n",
+        chain.usPerMb, chain.reads, chain.cmdsPerMb, chain.fatPerMb);
+    printf("bench: raw sectors of contiguous file: %.0f us/MB, %u f_read, %.0f disk_read/MB, %.0f FAT lookup/MB\n",
+        raw.usPerMb, raw.reads, raw.cmdsPerMb, raw.fatPerMb);
+    printf("bench: raw sectors bound at unaligned position: %.0f us/MB, %u f_read, %.0f disk_read/MB\n",
+        rawUnaligned.usPerMb, rawUnaligned.reads, rawUnaligned.cmdsPerMb);
+}
+
+int main()
+{
+    io_service_init();
+    for (const char* name : {"a", "b", "c", "d"}) { host_dir_add(name, 0); }
+    testRecover();
+    testGiveUp();
+    benchStream();
+    benchRaw();
+    ReadBuffer::printErrorStats();
+    if (failures > 0) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}